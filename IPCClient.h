@@ -0,0 +1,98 @@
+#ifndef IPC_CLIENT_H_
+#define IPC_CLIENT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <time.h>
+
+// Initial size of a subscriber's event ring, which grows with the number of
+// event kinds and monitors it has something pending for
+#define IPC_QUEUE_LEN 32
+
+typedef struct IPCClient IPCClient;
+
+/**
+ * An encoded event waiting in a subscriber's ring. At most one is kept per
+ * event kind and monitor; a newer one drops it and is queued at the tail.
+ */
+typedef struct IPCQueuedEvent {
+  int event;
+  int mon_num;
+  uint32_t size;
+  char *msg;
+} IPCQueuedEvent;
+
+/**
+ * This structure contains the details of an IPC Client and pointers for a
+ * linked list
+ */
+struct IPCClient {
+  int fd;
+  int subscriptions;
+  // Only deliver events about this monitor, -1 for all monitors
+  int monitor;
+
+  // Pending output, flushed whenever the socket reports EPOLLOUT
+  char *buffer;
+  uint32_t buffer_size;
+  uint32_t buffer_cap;
+  // CLOCK_MONOTONIC seconds since which output has been pending without the
+  // client reading any of it, 0 while there is none
+  time_t stalled_since;
+
+  // Bytes received so far that do not yet form a whole message
+  char *rbuffer;
+  uint32_t rbuffer_size;
+  uint32_t rbuffer_cap;
+
+  // Ring of events held back while the output buffer is not yet drained
+  IPCQueuedEvent *queue;
+  int queue_cap;
+  int queue_head;
+  int queue_len;
+  uint32_t queue_bytes;
+
+  struct epoll_event event;
+  IPCClient *next;
+  IPCClient *prev;
+};
+
+typedef IPCClient *IPCClientList;
+
+/**
+ * Allocate memory for new IPCClient with the specified file descriptor and
+ * initialize struct.
+ *
+ * @param fd File descriptor of IPC client
+ *
+ * @return Address to allocated IPCClient struct
+ */
+IPCClient *ipc_client_new(int fd);
+
+/**
+ * Add an IPC Client to the specified list
+ *
+ * @param list Address of the list to add the client to
+ * @param nc Address of the IPCClient
+ */
+void ipc_list_add_client(IPCClientList *list, IPCClient *nc);
+
+/**
+ * Remove an IPCClient from the specified list
+ *
+ * @param list Address of the list to remove the client from
+ * @param c Address of the IPCClient
+ */
+void ipc_list_remove_client(IPCClientList *list, IPCClient *c);
+
+/**
+ * Get an IPCClient from the specified IPCClient list
+ *
+ * @param list List to remove the client from
+ * @param fd File descriptor of the IPCClient
+ */
+IPCClient *ipc_list_get_client(IPCClientList list, int fd);
+
+#endif  // IPC_CLIENT_H_
@@ -0,0 +1,159 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * how long measuring bar text spends finding runs of 7-bit bytes, with the
+ * portable scanner and with asciirun() as built, against decoding every
+ * character through utf8decode(), and how long extent_create() takes when
+ * a display is there to load a font from. Build with make bench. */
+#include <time.h>
+
+#include "drw.c"
+
+#define LENGTH(X)               (sizeof X / sizeof X[0])
+
+static const char *samples[] = {
+	"[tile] 3/5 | cpu 12% | mem 4.1G | bat 87% | Fri 16 Oct 14:02",
+	"vim ~/src/dwm/drw.c - NVIM",
+	"Mozilla Firefox \xe2\x80\x94 Some page title that is rather long indeed",
+	"\xe2\x99\xaa  Artist \xe2\x80\x93 Song  \xf0\x9f\x94\x8a 60%  \xe2\x98\x80 21\xc2\xb0" "C",
+};
+
+static const struct {
+	const char *name;
+	size_t (*scan)(const unsigned char *, size_t);
+} scanners[] = {
+	{ "asciirun_scalar", asciirun_scalar },
+	{ "asciirun",        asciirun },
+};
+
+/* results go here once per pass, so the loops keep them in registers */
+static volatile unsigned long sink;
+
+static long long
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* what extent_create() did for every character before asciirun */
+__attribute__((noinline)) static unsigned long
+decode_all(const char *text)
+{
+	const char *p;
+	long cp;
+	size_t clen;
+	unsigned long sum = 0;
+
+	for (p = text; *p; p += clen) {
+		clen = utf8decode(p, &cp, UTF_SIZ);
+		sum += cp;
+	}
+	return sum;
+}
+
+/* the decoding extent_create() does now: a scan per run of 7-bit bytes and
+ * utf8decode() for the rest */
+__attribute__((noinline)) static unsigned long
+decode_runs(const char *text, size_t len, size_t (*scan)(const unsigned char *, size_t))
+{
+	const char *p;
+	long cp;
+	size_t clen;
+	unsigned long sum = 0;
+
+	for (p = text; *p; p += clen) {
+		if (!((unsigned char)*p & 0x80)) {
+			clen = scan((const unsigned char *)p, text + len - p);
+			sum += clen;
+		} else {
+			clen = utf8decode(p, &cp, UTF_SIZ);
+			sum += cp;
+		}
+	}
+	return sum;
+}
+
+static void
+report(const char *what, const char *name, long long ns, double per, const char *unit)
+{
+	printf("%-14s %-16s %9.3f %s\n", what, name, ns / per, unit);
+}
+
+static void
+bench_decode(int rounds)
+{
+	size_t i, j, len[LENGTH(samples)], bytes = 0;
+	unsigned long sum;
+	long long t;
+	int r;
+
+	for (i = 0; i < LENGTH(samples); i++)
+		bytes += (len[i] = strlen(samples[i])) * rounds;
+
+	t = now();
+	for (r = 0, sum = 0; r < rounds; r++)
+		for (i = 0; i < LENGTH(samples); i++)
+			sum += decode_all(samples[i]);
+	sink = sum;
+	report("decode", "utf8decode", now() - t, bytes, "ns/byte");
+
+	for (j = 0; j < LENGTH(scanners); j++) {
+		t = now();
+		for (r = 0, sum = 0; r < rounds; r++)
+			for (i = 0; i < LENGTH(samples); i++)
+				sum += decode_runs(samples[i], len[i], scanners[j].scan);
+		sink = sum;
+		report("decode", scanners[j].name, now() - t, bytes, "ns/byte");
+	}
+}
+
+/* the whole layout, built and thrown away without going through the cache */
+static void
+bench_extent(int rounds)
+{
+	Display *dpy;
+	Drw *drw;
+	Extent *e;
+	const char *fonts[] = { "monospace:size=10" };
+	size_t i;
+	unsigned long sum;
+	long long t;
+	int r, screen;
+
+	if (!(dpy = XOpenDisplay(NULL))) {
+		puts("extent_create: no display, skipped");
+		return;
+	}
+	screen = DefaultScreen(dpy);
+	drw = drw_create(dpy, screen, RootWindow(dpy, screen), 1, 1,
+		DefaultVisual(dpy, screen), DefaultDepth(dpy, screen), DefaultColormap(dpy, screen));
+	if (!drw_fontset_create(drw, fonts, LENGTH(fonts)))
+		die("no fonts could be loaded.");
+	t = now();
+	for (r = 0, sum = 0; r < rounds; r++)
+		for (i = 0; i < LENGTH(samples); i++) {
+			e = extent_create(drw, samples[i], 0);
+			sum += e->adv[e->nchars];
+			free(e->text);
+			free(e->off);
+			free(e->runs);
+			free(e);
+		}
+	sink = sum;
+	report("extent_create", fonts[0], now() - t,
+		(double)rounds * LENGTH(samples), "ns/string");
+	drw_free(drw);
+	XCloseDisplay(dpy);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+
+	bench_decode(rounds);
+	bench_extent(rounds / 10);
+	return 0;
+}
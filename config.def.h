@@ -160,6 +160,18 @@ static Button buttons[] = {
 };
 
 static const char *ipcsockpath = "/tmp/dwm.sock";
+static const char *statussockpath = "/tmp/dwm-status.sock"; /* datagrams of name\ttext or name\tfg\tbg\ttext */
+
+/* status modules, each shown as the segment of its name; ticks fall on
+ * multiples of the interval in seconds, so the clock turns with the minute */
+static const Module modules[] = {
+	/* name     function     argument                                 interval */
+	{ "cpu",    modcpu,      "/proc/stat",                            2 },
+	{ "mem",    modmem,      "/proc/meminfo",                         5 },
+	/* laptops only, name the supply under /sys/class/power_supply */
+	/* { "bat", modbattery, "/sys/class/power_supply/BAT0/uevent", 30 }, */
+	{ "clock",  modclock,    "%a %d %b %R",                           60 },
+};
 static IPCCommand ipccommands[] = {
   IPCCOMMAND(  view,                1,      {ARG_TYPE_UINT}   ),
   IPCCOMMAND(  toggleview,          1,      {ARG_TYPE_UINT}   ),
@@ -14,6 +14,14 @@ X11LIB = /usr/X11R6/lib
 XINERAMALIBS  = -lXinerama
 XINERAMAFLAGS = -DXINERAMA
 
+# Xrandr, for the refresh rate of each monitor, comment if you don't want it
+XRANDRLIBS  = -lXrandr
+XRANDRFLAGS = -DXRANDR
+
+# MIT-SHM, to rasterize the bar client-side on a local server, comment if you don't want it
+XSHMLIBS  = -lXext -lfreetype
+XSHMFLAGS = -DXSHM
+
 # freetype
 FREETYPELIBS = -lfontconfig -lXft
 FREETYPEINC = /usr/include/freetype2
@@ -22,15 +30,15 @@ FREETYPEINC = /usr/include/freetype2
 #KVMLIB = -lkvm
 
 # yajl
-#YAJLLIBS = -lyajl
-#YAJLINC = /usr/include/yajl
+YAJLLIBS = -lyajl
+YAJLINC = /usr/include/yajl
 
 # includes and libs
 INCS = -I${X11INC} -I${FREETYPEINC} -I${YAJLINC}
-LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${FREETYPELIBS} -lX11-xcb -lxcb -lxcb-res -lXrender ${KVMLIB}
+LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${XRANDRLIBS} ${XSHMLIBS} ${FREETYPELIBS} -lX11-xcb -lxcb -lxcb-res -lXrender ${YAJLLIBS} ${KVMLIB}
 
 # flags
-CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_POSIX_C_SOURCE=2 -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS}
+CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_POSIX_C_SOURCE=2 -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS} ${XRANDRFLAGS} ${XSHMFLAGS}
 #CFLAGS   = -g -std=c99 -pedantic -Wall -O0 ${INCS} ${CPPFLAGS}
 CFLAGS   = -march=native -mtune=native -std=c99 -pedantic -Wall -pie -pipe -Wno-unused-function -Wno-deprecated-declarations -flto=1 -Ofast ${INCS} ${CPPFLAGS}
 LDFLAGS  = ${LIBS}
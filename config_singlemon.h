@@ -52,6 +52,16 @@ static const char *alttrayname      = "tray";    /* Polybar tray instance name *
 static const char *altbarcmd        = "~/.config/polybar/launch.sh"; /* Alternate bar launch command */
 static const char *startcmd         = "~/suckless/autostart/autorun"; /* Autostart your stuff */
 static const char *ipcsockpath = "/tmp/dwm.sock";
+static const char *statussockpath = "/tmp/dwm-status.sock";
+
+/* status modules, see config.def.h */
+static const Module modules[] = {
+	/* name     function     argument                                 interval */
+	{ "cpu",    modcpu,      "/proc/stat",                            2 },
+	{ "mem",    modmem,      "/proc/meminfo",                         5 },
+	/* { "bat", modbattery, "/sys/class/power_supply/BAT0/uevent", 30 }, */
+	{ "clock",  modclock,    "%a %d %b %R",                           60 },
+};
 
 
 
@@ -258,7 +268,6 @@ static Button buttons[] = {
 	{ ClkTagBar,            MODKEY,         Button3,        toggletag,      {0} },
 };
 
-/*
 static IPCCommand ipccommands[] = {
   IPCCOMMAND(  view,                1,      {ARG_TYPE_UINT}   ),
   IPCCOMMAND(  toggleview,          1,      {ARG_TYPE_UINT}   ),
@@ -276,5 +285,4 @@ static IPCCommand ipccommands[] = {
   IPCCOMMAND(  setlayoutsafe,       1,      {ARG_TYPE_PTR}    ),
   IPCCOMMAND(  quit,                1,      {ARG_TYPE_NONE}   )
 };
-*/
 /*vim: set noexpandtab: */
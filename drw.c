@@ -1,4 +1,5 @@
 /* See LICENSE file for copyright and license details. */
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,9 +9,97 @@
 #include "drw.h"
 #include "util.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+#ifdef XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#include FT_LCD_FILTER_H
+#endif /* XSHM */
+
 #define UTF_INVALID 0xFFFD
 #define UTF_SIZ     4
 
+#define EXTENTHASH  256  /* power of two */
+#define EXTENTMAX   128  /* strings whose layout is kept */
+
+#define LABELMAX    64   /* pre-rendered labels kept */
+#define GLYPHHASH   1024 /* power of two */
+#define COVERPAGES  (0x10000 >> 8)  /* pages of 256 codepoints span the BMP */
+#define NOFONT      0xff          /* no font has the codepoint, not even a fallback */
+
+/* a stretch of text drawn with one font, as character indices */
+typedef struct {
+	Fnt *font;
+	unsigned int start, end;
+} TextRun;
+
+/* the layout of a string in a fontset: where each character starts and how
+ * far the pen has advanced before it, so widths of prefixes are lookups */
+struct Extent {
+	Fnt *set;
+	char *text;
+	unsigned int hash;
+	unsigned int nchars, nruns;
+	unsigned int *off;  /* byte offset of each character, nchars + 1 */
+	unsigned int *adv;  /* advance before each character, nchars + 1 */
+	TextRun *runs;
+	Extent *hnext;
+	Extent *prev, *next;
+};
+
+/* text that rarely changes, drawn once per fontset, scheme and size */
+struct Label {
+	char text[32];
+	Fnt *set;
+	Clr *scheme;
+	int invert;
+	unsigned int w, h, lpad;
+	Buf *buf;
+	unsigned long used;
+};
+
+/* pixels the bar is rasterized into by us rather than the server */
+struct Image {
+	XImage *ximg;
+	uint32_t *data;
+	unsigned int w, h, stride;  /* stride in pixels */
+#ifdef XSHM
+	XShmSegmentInfo shm;        /* shmid is -1 for private memory */
+#endif /* XSHM */
+	int pending;                /* the server may still be reading it */
+	Image *next;
+};
+
+/* a glyph's coverage, one byte per pixel, kept in the atlas */
+typedef struct GlyphCov GlyphCov;
+struct GlyphCov {
+	Fnt *font;
+	long cp;
+	int left, top;       /* of the bitmap, from the pen on the baseline */
+	unsigned int w, h;
+	unsigned int bpp;    /* bytes of coverage per pixel, 3 for subpixels */
+	size_t off;
+	GlyphCov *next;
+};
+
+struct Atlas {
+	GlyphCov *glyphs[GLYPHHASH];
+	unsigned char *cov;
+	size_t len, size;
+};
+
+/* per codepoint the index + 1 of the font drawing it, 0 when not yet known;
+ * the BMP in lazily allocated pages, the rest open addressed */
+struct Coverage {
+	unsigned char *page[COVERPAGES];
+	long *astralcp;
+	unsigned char *astralfont;
+	unsigned int nastral, astralsize;  /* astralsize is a power of two */
+};
+
 static const unsigned char utfbyte[UTF_SIZ + 1] = {0x80,    0, 0xC0, 0xE0, 0xF0};
 static const unsigned char utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
 static const long utfmin[UTF_SIZ + 1] = {       0,    0,  0x80,  0x800,  0x10000};
@@ -60,10 +149,470 @@ utf8decode(const char *c, long *u, size_t clen)
 	return len;
 }
 
+/* the number of leading 7-bit bytes in s[0..n), which decode to themselves */
+static size_t
+asciirun_scalar(const unsigned char *s, size_t n)
+{
+	size_t i = 0;
+	uint64_t v;
+
+	for (; n - i >= sizeof(v); i += sizeof(v)) {
+		memcpy(&v, s + i, sizeof(v));
+		if (v & 0x8080808080808080ULL)
+			break;
+	}
+	for (; i < n && !(s[i] & 0x80); i++);
+	return i;
+}
+
+/* sixteen bytes at a time where SSE2 is there to begin with; wider vectors
+ * and picking one at run time lose on runs as short as bar text's, as
+ * make bench shows */
+static size_t
+asciirun(const unsigned char *s, size_t n)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	int mask;
+
+	for (; n - i >= 16; i += 16)
+		if ((mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i)))))
+			return i + __builtin_ctz(mask);
+#endif /* __SSE2__ */
+	return i + asciirun_scalar(s + i, n - i);
+}
+
+#ifdef XSHM
+static int shmfailed;
+
+static int
+shmerror(Display *dpy, XErrorEvent *ee)
+{
+	shmfailed = 1;
+	return 0;
+}
+
+static int
+image_attach(Drw *drw, Image *im)
+{
+	XErrorHandler xerror;
+
+	im->shm.shmid = shmget(IPC_PRIVATE, im->ximg->bytes_per_line * im->h, IPC_CREAT | 0600);
+	if (im->shm.shmid == -1)
+		return 0;
+	im->shm.shmaddr = im->ximg->data = shmat(im->shm.shmid, NULL, 0);
+	im->shm.readOnly = False;
+	if (im->shm.shmaddr == (char *)-1) {
+		shmctl(im->shm.shmid, IPC_RMID, NULL);
+		im->shm.shmid = -1;
+		im->ximg->data = NULL;
+		return 0;
+	}
+	/* a remote server fails the attach, and only tells asynchronously */
+	shmfailed = 0;
+	xerror = XSetErrorHandler(shmerror);
+	XShmAttach(drw->dpy, &im->shm);
+	XSync(drw->dpy, False);
+	XSetErrorHandler(xerror);
+	/* gone once both sides detach */
+	shmctl(im->shm.shmid, IPC_RMID, NULL);
+	if (shmfailed) {
+		shmdt(im->shm.shmaddr);
+		im->shm.shmid = -1;
+		im->ximg->data = NULL;
+		return 0;
+	}
+	return 1;
+}
+#endif /* XSHM */
+
+/* pixels of w x h, shared with the server if it can be, private otherwise */
+static Image *
+image_create(Drw *drw, unsigned int w, unsigned int h, int shared)
+{
+	Image *im = ecalloc(1, sizeof(Image));
+
+	im->w = w;
+	im->h = h;
+#ifdef XSHM
+	im->shm.shmid = -1;
+	if (shared && (im->ximg = XShmCreateImage(drw->dpy, drw->visual, drw->depth,
+	                                        ZPixmap, NULL, &im->shm, w, h))
+	&& !image_attach(drw, im)) {
+		XDestroyImage(im->ximg);
+		im->ximg = NULL;
+	}
+	if (im->shm.shmid != -1) {
+		im->next = drw->images;
+		drw->images = im;
+	}
+#endif /* XSHM */
+	if (!im->ximg)
+		im->ximg = XCreateImage(drw->dpy, drw->visual, drw->depth, ZPixmap, 0,
+		                        ecalloc(w * h, sizeof(uint32_t)), w, h, 32, 0);
+	im->data = (uint32_t *)im->ximg->data;
+	im->stride = im->ximg->bytes_per_line / sizeof(uint32_t);
+
+	return im;
+}
+
+static void
+image_free(Drw *drw, Image *im)
+{
+	if (!im)
+		return;
+#ifdef XSHM
+	if (im->shm.shmid != -1) {
+		Image **ti;
+
+		for (ti = &drw->images; *ti != im; ti = &(*ti)->next);
+		*ti = im->next;
+		XShmDetach(drw->dpy, &im->shm);
+		shmdt(im->shm.shmaddr);
+		im->ximg->data = NULL;
+	}
+#endif /* XSHM */
+	XDestroyImage(im->ximg);
+	free(im);
+}
+
+/* whether the bar can be rasterized here: a local server with MIT-SHM and
+ * 8 bit channels in 32 bit pixels of the byte order we write */
+static int
+image_probe(Drw *drw)
+{
+#ifdef XSHM
+	const char *name = DisplayString(drw->dpy);
+	const uint32_t one = 1;
+	Image *im;
+	int ok;
+
+	if (!XShmQueryExtension(drw->dpy) || (name[0] != ':' && strncmp(name, "unix:", 5)))
+		return 0;
+	if ((drw->depth != 24 && drw->depth != 32) || drw->visual->red_mask != 0xff0000
+	|| drw->visual->green_mask != 0xff00 || drw->visual->blue_mask != 0xff)
+		return 0;
+	im = image_create(drw, 1, 1, 1);
+	ok = im->shm.shmid != -1 && im->ximg->bits_per_pixel == 32
+	     && im->ximg->byte_order == (*(const char *)&one ? LSBFirst : MSBFirst);
+	image_free(drw, im);
+	return ok ? XShmGetEventBase(drw->dpy) + ShmCompletion : 0;
+#else
+	return 0;
+#endif /* XSHM */
+}
+
+static void
+image_fill(Image *im, int x, int y, int w, int h, uint32_t px)
+{
+	uint32_t *row;
+	int i;
+
+	if (x < 0) {
+		w += x;
+		x = 0;
+	}
+	if (y < 0) {
+		h += y;
+		y = 0;
+	}
+	w = MIN(w, (int)im->w - x);
+	h = MIN(h, (int)im->h - y);
+	for (row = im->data + y * im->stride + x; h > 0; h--, row += im->stride)
+		for (i = 0; i < w; i++)
+			row[i] = px;
+}
+
+/* src onto dst at x, y */
+static void
+image_copy(Image *dst, int x, int y, const Image *src)
+{
+	int sx = 0, sy = 0, w = src->w, h = src->h;
+
+	if (x < 0) {
+		sx = -x;
+		w += x;
+		x = 0;
+	}
+	if (y < 0) {
+		sy = -y;
+		h += y;
+		y = 0;
+	}
+	w = MIN(w, (int)dst->w - x);
+	h = MIN(h, (int)dst->h - y);
+	for (; w > 0 && h > 0; h--, y++, sy++)
+		memcpy(dst->data + y * dst->stride + x, src->data + sy * src->stride + sx,
+		       w * sizeof(uint32_t));
+}
+
+static void
+atlas_flush(Atlas *a)
+{
+	GlyphCov *g;
+	unsigned int i;
+
+	for (i = 0; i < GLYPHHASH; i++)
+		while ((g = a->glyphs[i])) {
+			a->glyphs[i] = g->next;
+			free(g);
+		}
+	a->len = 0;
+}
+
+#ifdef XSHM
+/* each byte of dst moved towards fg by the coverage of its pixel */
+static void
+blendrow(uint32_t *dst, const unsigned char *cov, unsigned int n, uint32_t fg)
+{
+	unsigned int i = 0, c, k;
+	uint32_t d, px;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi16(256);
+	const __m128i f = _mm_unpacklo_epi8(_mm_set1_epi32(fg), zero);
+	__m128i a, clo, chi, dst4, dlo, dhi;
+	uint32_t c4;
+
+	for (; i + 4 <= n; i += 4) {
+		memcpy(&c4, cov + i, sizeof(c4));
+		if (!c4)
+			continue;
+		/* every byte of a pixel gets its coverage, scaled to 0..256 */
+		a = _mm_cvtsi32_si128(c4);
+		a = _mm_unpacklo_epi8(a, a);
+		a = _mm_unpacklo_epi16(a, a);
+		clo = _mm_unpacklo_epi8(a, zero);
+		chi = _mm_unpackhi_epi8(a, zero);
+		clo = _mm_add_epi16(clo, _mm_srli_epi16(clo, 7));
+		chi = _mm_add_epi16(chi, _mm_srli_epi16(chi, 7));
+		dst4 = _mm_loadu_si128((const __m128i *)(dst + i));
+		dlo = _mm_unpacklo_epi8(dst4, zero);
+		dhi = _mm_unpackhi_epi8(dst4, zero);
+		/* d * (256 - c) + f * c stays below 65536 */
+		dlo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(dlo, _mm_sub_epi16(full, clo)),
+		                                   _mm_mullo_epi16(f, clo)), 8);
+		dhi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(dhi, _mm_sub_epi16(full, chi)),
+		                                   _mm_mullo_epi16(f, chi)), 8);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(dlo, dhi));
+	}
+#endif /* __SSE2__ */
+	for (; i < n; i++) {
+		if (!(c = cov[i]))
+			continue;
+		c += c >> 7;
+		for (d = dst[i], px = 0, k = 0; k < 32; k += 8)
+			px |= ((((d >> k) & 0xff) * (256 - c) + ((fg >> k) & 0xff) * c) >> 8) << k;
+		dst[i] = px;
+	}
+}
+
+/* blendrow() with a coverage per subpixel, stored red, green, blue */
+static void
+blendlcd(uint32_t *dst, const unsigned char *cov, unsigned int n, uint32_t fg)
+{
+	unsigned int i, k, c[4];
+	uint32_t d, px;
+
+	for (i = 0; i < n; i++, cov += 3) {
+		if (!(cov[0] | cov[1] | cov[2]))
+			continue;
+		/* by byte of the pixel: blue, green, red, alpha */
+		c[0] = cov[2];
+		c[1] = cov[1];
+		c[2] = cov[0];
+		c[3] = MAX(MAX(cov[0], cov[1]), cov[2]);
+		for (d = dst[i], px = 0, k = 0; k < 4; k++) {
+			c[k] += c[k] >> 7;
+			px |= ((((d >> 8 * k) & 0xff) * (256 - c[k])
+			      + ((fg >> 8 * k) & 0xff) * c[k]) >> 8) << 8 * k;
+		}
+		dst[i] = px;
+	}
+}
+
+/* the load flags and render mode Xft uses for font, from the antialias,
+ * hinting, hintstyle, autohint, rgba and lcdfilter of its pattern */
+static FT_Render_Mode
+glyph_mode(Fnt *font, FT_Int32 *flags, int *rgba, FT_LcdFilter *filter)
+{
+	FcPattern *p = font->xfont->pattern;
+	FcBool aa = FcTrue, hinting = FcTrue, autohint = FcFalse;
+	int hintstyle = FC_HINT_FULL, lcd = FC_LCD_DEFAULT;
+
+	*rgba = FC_RGBA_UNKNOWN;
+	FcPatternGetBool(p, FC_ANTIALIAS, 0, &aa);
+	FcPatternGetBool(p, FC_HINTING, 0, &hinting);
+	FcPatternGetInteger(p, FC_HINT_STYLE, 0, &hintstyle);
+	FcPatternGetBool(p, FC_AUTOHINT, 0, &autohint);
+	FcPatternGetInteger(p, FC_RGBA, 0, rgba);
+	FcPatternGetInteger(p, FC_LCD_FILTER, 0, &lcd);
+
+	*flags = FT_LOAD_DEFAULT;
+	if (!hinting || hintstyle == FC_HINT_NONE)
+		*flags |= FT_LOAD_NO_HINTING;
+	if (autohint)
+		*flags |= FT_LOAD_FORCE_AUTOHINT;
+	*filter = lcd == FC_LCD_NONE ? FT_LCD_FILTER_NONE
+	        : lcd == FC_LCD_LIGHT ? FT_LCD_FILTER_LIGHT
+	        : lcd == FC_LCD_LEGACY ? FT_LCD_FILTER_LEGACY : FT_LCD_FILTER_DEFAULT;
+
+	if (!aa) {
+		*rgba = FC_RGBA_NONE;
+		*flags |= FT_LOAD_TARGET_MONO;
+		return FT_RENDER_MODE_MONO;
+	}
+	switch (*rgba) {
+	case FC_RGBA_RGB:
+	case FC_RGBA_BGR:
+		*flags |= FT_LOAD_TARGET_LCD;
+		return FT_RENDER_MODE_LCD;
+	case FC_RGBA_VRGB:
+	case FC_RGBA_VBGR:
+		*flags |= FT_LOAD_TARGET_LCD_V;
+		return FT_RENDER_MODE_LCD_V;
+	}
+	*rgba = FC_RGBA_NONE;
+	if (hintstyle == FC_HINT_SLIGHT) {
+		*flags |= FT_LOAD_TARGET_LIGHT;
+		return FT_RENDER_MODE_LIGHT;
+	}
+	*flags |= FT_LOAD_TARGET_NORMAL;
+	return FT_RENDER_MODE_NORMAL;
+}
+
+/* the glyph of cp in font, rendered by FreeType on first use the way Xft
+ * would; one that fails to render is kept empty */
+static GlyphCov *
+glyph_get(Drw *drw, Fnt *font, long cp)
+{
+	Atlas *a = drw->atlas;
+	GlyphCov *g;
+	FT_Face face;
+	FT_Bitmap *bm;
+	FT_Render_Mode mode;
+	FT_LcdFilter filter;
+	FT_Int32 flags;
+	int rgba, bgr;
+	unsigned int h = ((uintptr_t)font >> 4 ^ cp * 2654435761u) & (GLYPHHASH - 1), x, y, k;
+	unsigned char *dst, *src;
+
+	for (g = a->glyphs[h]; g; g = g->next)
+		if (g->font == font && g->cp == cp)
+			return g;
+	g = ecalloc(1, sizeof(GlyphCov));
+	g->font = font;
+	g->cp = cp;
+	g->bpp = 1;
+	g->next = a->glyphs[h];
+	a->glyphs[h] = g;
+
+	if (!(face = XftLockFace(font->xfont)))
+		return g;
+	mode = glyph_mode(font, &flags, &rgba, &filter);
+	if (mode == FT_RENDER_MODE_LCD || mode == FT_RENDER_MODE_LCD_V)
+		FT_Library_SetLcdFilter(face->glyph->library, filter);
+	if (!FT_Load_Glyph(face, XftCharIndex(drw->dpy, font->xfont, cp), flags)
+	&& !FT_Render_Glyph(face->glyph, mode)) {
+		bm = &face->glyph->bitmap;
+		g->left = face->glyph->bitmap_left;
+		g->top = face->glyph->bitmap_top;
+		g->w = bm->width;
+		g->h = bm->rows;
+		if (bm->pixel_mode == FT_PIXEL_MODE_LCD)
+			g->w /= 3;
+		else if (bm->pixel_mode == FT_PIXEL_MODE_LCD_V)
+			g->h /= 3;
+		else if (bm->pixel_mode != FT_PIXEL_MODE_GRAY && bm->pixel_mode != FT_PIXEL_MODE_MONO)
+			g->w = g->h = 0;
+		if (bm->pixel_mode == FT_PIXEL_MODE_LCD || bm->pixel_mode == FT_PIXEL_MODE_LCD_V)
+			g->bpp = 3;
+		/* FreeType renders subpixels in RGB order, the screen may not */
+		bgr = rgba == FC_RGBA_BGR || rgba == FC_RGBA_VBGR;
+		g->off = a->len;
+		if (a->len + g->w * g->h * g->bpp > a->size) {
+			a->size = MAX(2 * a->size, a->len + g->w * g->h * g->bpp);
+			if (!(a->cov = realloc(a->cov, a->size)))
+				die("realloc:");
+		}
+		dst = a->cov + g->off;
+		for (y = 0; y < g->h; y++, dst += g->w * g->bpp) {
+			src = bm->buffer + (long)y * bm->pitch;
+			for (x = 0; x < g->w; x++) {
+				switch (bm->pixel_mode) {
+				case FT_PIXEL_MODE_GRAY:
+					dst[x] = src[x] * 255 / (bm->num_grays - 1);
+					break;
+				case FT_PIXEL_MODE_MONO:
+					dst[x] = (src[x >> 3] & 0x80 >> (x & 7)) ? 255 : 0;
+					break;
+				case FT_PIXEL_MODE_LCD:
+					for (k = 0; k < 3; k++)
+						dst[3 * x + k] = src[3 * x + (bgr ? 2 - k : k)];
+					break;
+				case FT_PIXEL_MODE_LCD_V:
+					for (k = 0; k < 3; k++)
+						dst[3 * x + k] = bm->buffer[(long)(3 * y + (bgr ? 2 - k : k)) * bm->pitch + x];
+					break;
+				}
+			}
+		}
+		a->len += g->w * g->h * g->bpp;
+	}
+	XftUnlockFace(font->xfont);
+	return g;
+}
+
+static void
+image_glyph(Drw *drw, Fnt *font, long cp, int x, int ty, uint32_t fg)
+{
+	Image *im = drw->img;
+	GlyphCov *g = glyph_get(drw, font, cp);
+	int gx, gy, sx, sy, w, h;
+
+	gx = x + g->left;
+	gy = ty - g->top;
+	sx = MAX(0, -gx);
+	sy = MAX(0, -gy);
+	w = MIN((int)g->w, (int)im->w - gx) - sx;
+	h = MIN((int)g->h, (int)im->h - gy) - sy;
+	for (; w > 0 && h > 0; h--, sy++)
+		(g->bpp == 3 ? blendlcd : blendrow)(im->data + (gy + sy) * im->stride + gx + sx,
+		         drw->atlas->cov + g->off + (sy * g->w + sx) * g->bpp, w, fg);
+}
+
+/* what XftDrawStringUtf8() would draw of text, characters [start, end) of e
+ * with their last ndots bytes turned into dots, pen at x on baseline ty;
+ * whole characters advance as e measured them, only the dots are measured
+ * here */
+static void
+image_string(Drw *drw, Fnt *font, const Extent *e, unsigned int start, unsigned int end,
+             int x, int ty, const char *text, size_t ndots, uint32_t fg)
+{
+	unsigned int k, base = e->off[start];
+	size_t len = e->off[end] - base, clen;
+	long cp;
+	unsigned int ew;
+
+	for (k = start; k < end && e->off[k + 1] - base <= len - ndots; k++) {
+		utf8decode(e->text + e->off[k], &cp, e->off[k + 1] - e->off[k]);
+		image_glyph(drw, font, cp, x + e->adv[k] - e->adv[start], ty, fg);
+	}
+	x += e->adv[k] - e->adv[start];
+	for (text += e->off[k] - base, len -= e->off[k] - base; len;
+	     text += clen, len -= clen, x += ew) {
+		clen = utf8decode(text, &cp, MIN(len, UTF_SIZ));
+		drw_font_getexts(font, text, clen, &ew, NULL);
+		image_glyph(drw, font, cp, x, ty, fg);
+	}
+}
+#endif /* XSHM */
+
 Drw *
 drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h, Visual *visual, unsigned int depth, Colormap cmap)
 {
 	Drw *drw = ecalloc(1, sizeof(Drw));
+	Pixmap gcpixmap;
 
 	drw->dpy = dpy;
 	drw->screen = screen;
@@ -73,8 +622,17 @@ drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h
 	drw->visual = visual;
 	drw->depth = depth;
 	drw->cmap = cmap;
-	drw->drawable = XCreatePixmap(dpy, root, w, h, depth);
-	drw->gc = XCreateGC(dpy, drw->drawable, 0, NULL);
+	drw->atlas = ecalloc(1, sizeof(Atlas));
+	drw->shmcompletion = image_probe(drw);
+	drw->own = drw_buf_create(drw, w, h);
+	drw_setbuf(drw, drw->own);
+	/* with no pixmap to go by, for a GC of the right depth */
+	gcpixmap = XCreatePixmap(dpy, root, 1, 1, depth);
+	drw->gc = XCreateGC(dpy, gcpixmap, 0, NULL);
+	XFreePixmap(dpy, gcpixmap);
+	drw->extents = ecalloc(EXTENTHASH, sizeof(Extent *));
+	drw->coverage = ecalloc(1, sizeof(Coverage));
+	drw->labels = ecalloc(LABELMAX, sizeof(Label));
 	XSetLineAttributes(dpy, drw->gc, 1, LineSolid, CapButt, JoinMiter);
 
 	return drw;
@@ -88,19 +646,202 @@ drw_resize(Drw *drw, unsigned int w, unsigned int h)
 
 	drw->w = w;
 	drw->h = h;
-	if (drw->drawable)
-		XFreePixmap(drw->dpy, drw->drawable);
-	drw->drawable = XCreatePixmap(drw->dpy, drw->root, w, h, drw->depth);
+	drw_buf_free(drw, drw->own);
+	drw->own = drw_buf_create(drw, w, h);
+	drw_setbuf(drw, drw->own);
+}
+
+/* a buffer rasterized client-side when the server has MIT-SHM, shared with
+ * it when it is to be put on a window */
+static Buf *
+buf_create(Drw *drw, unsigned int w, unsigned int h, int shared)
+{
+	Buf *buf = ecalloc(1, sizeof(Buf));
+
+	buf->w = w;
+	buf->h = h;
+	if (drw->shmcompletion) {
+		buf->img = image_create(drw, w, h, shared);
+		/* drawn into while the server is still reading img */
+		if (shared)
+			buf->spare = image_create(drw, w, h, 1);
+	} else {
+		buf->pixmap = XCreatePixmap(drw->dpy, drw->root, w, h, drw->depth);
+		buf->xftdraw = XftDrawCreate(drw->dpy, buf->pixmap, drw->visual, drw->cmap);
+	}
+
+	return buf;
+}
+
+Buf *
+drw_buf_create(Drw *drw, unsigned int w, unsigned int h)
+{
+	return buf_create(drw, w, h, 1);
+}
+
+void
+drw_buf_free(Drw *drw, Buf *buf)
+{
+	if (!buf)
+		return;
+	if (buf->img) {
+		if (drw->img == buf->img || drw->img == buf->spare)
+			drw->img = NULL;
+		image_free(drw, buf->img);
+		image_free(drw, buf->spare);
+	} else {
+		if (drw->drawable == buf->pixmap) {
+			drw->drawable = None;
+			drw->xftdraw = NULL;
+		}
+		XftDrawDestroy(buf->xftdraw);
+		XFreePixmap(drw->dpy, buf->pixmap);
+	}
+	free(buf);
+}
+
+static void
+extent_free(Drw *drw, Extent *e)
+{
+	Extent **te;
+
+	for (te = &drw->extents[e->hash & (EXTENTHASH - 1)]; *te != e; te = &(*te)->hnext);
+	*te = e->hnext;
+	if (e->next == e) {
+		drw->lru = NULL;
+	} else {
+		e->prev->next = e->next;
+		e->next->prev = e->prev;
+		if (drw->lru == e)
+			drw->lru = e->next;
+	}
+	drw->nextents--;
+	free(e->text);
+	free(e->off);
+	free(e->runs);
+	free(e);
+}
+
+static void
+extent_flush(Drw *drw)
+{
+	while (drw->lru)
+		extent_free(drw, drw->lru);
+}
+
+static void
+coverage_flush(Coverage *cv)
+{
+	unsigned int i;
+
+	for (i = 0; i < COVERPAGES; i++) {
+		free(cv->page[i]);
+		cv->page[i] = NULL;
+	}
+	free(cv->astralcp);
+	free(cv->astralfont);
+	cv->astralcp = NULL;
+	cv->astralfont = NULL;
+	cv->nastral = cv->astralsize = 0;
+}
+
+static unsigned char *
+coverage_slot(Coverage *cv, long cp)
+{
+	unsigned int i, j, oldsize;
+	long *oldcp;
+	unsigned char *oldfont;
+
+	if (cp < 0x10000) {
+		if (!cv->page[cp >> 8])
+			cv->page[cp >> 8] = ecalloc(256, 1);
+		return &cv->page[cp >> 8][cp & 0xff];
+	}
+	if (2 * (cv->nastral + 1) > cv->astralsize) {
+		oldcp = cv->astralcp;
+		oldfont = cv->astralfont;
+		oldsize = cv->astralsize;
+		cv->astralsize = oldsize ? 2 * oldsize : 64;
+		cv->astralcp = ecalloc(cv->astralsize, sizeof(long));
+		cv->astralfont = ecalloc(cv->astralsize, 1);
+		for (i = 0; i < oldsize; i++) {
+			if (!oldfont[i])
+				continue;
+			for (j = oldcp[i] & (cv->astralsize - 1); cv->astralfont[j];
+			     j = (j + 1) & (cv->astralsize - 1));
+			cv->astralcp[j] = oldcp[i];
+			cv->astralfont[j] = oldfont[i];
+		}
+		free(oldcp);
+		free(oldfont);
+	}
+	for (i = cp & (cv->astralsize - 1); cv->astralfont[i] && cv->astralcp[i] != cp;
+	     i = (i + 1) & (cv->astralsize - 1));
+	if (!cv->astralfont[i]) {
+		cv->astralcp[i] = cp;
+		cv->nastral++;
+	}
+	return &cv->astralfont[i];
+}
+
+static void
+label_flush(Drw *drw)
+{
+	unsigned int i;
+
+	for (i = 0; i < LABELMAX; i++) {
+		drw_buf_free(drw, drw->labels[i].buf);
+		drw->labels[i].buf = NULL;
+	}
 }
 
 void
 drw_free(Drw *drw)
 {
-	XFreePixmap(drw->dpy, drw->drawable);
+	extent_flush(drw);
+	free(drw->extents);
+	coverage_flush(drw->coverage);
+	free(drw->coverage);
+	label_flush(drw);
+	free(drw->labels);
+	atlas_flush(drw->atlas);
+	free(drw->atlas->cov);
+	free(drw->atlas);
+	drw_buf_free(drw, drw->own);
 	XFreeGC(drw->dpy, drw->gc);
 	free(drw);
 }
 
+/* Fill font->ascii when every printable ASCII character is in the font and
+ * the advance of a string is the sum of its characters' advances; pairs that
+ * commonly kern or form ligatures and the whole range at once must agree. */
+static void
+xfont_ascii(Fnt *font)
+{
+	static const char *pairs[] = { "AV", "To", "WA", "LT", "Yo", "ff", "fi", "fl", "--", "=>" };
+	XGlyphInfo ext;
+	FcChar8 all[0x7f - 0x20];
+	unsigned int i, sum = 0;
+
+	for (i = 0; i < sizeof(all); i++) {
+		all[i] = 0x20 + i;
+		if (!XftCharExists(font->dpy, font->xfont, all[i]))
+			return;
+		XftTextExtents8(font->dpy, font->xfont, &all[i], 1, &ext);
+		font->ascii[i] = ext.xOff;
+		sum += ext.xOff;
+	}
+	XftTextExtents8(font->dpy, font->xfont, all, sizeof(all), &ext);
+	if (ext.xOff != (int)sum)
+		return;
+	for (i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+		XftTextExtents8(font->dpy, font->xfont, (const FcChar8 *)pairs[i], 2, &ext);
+		if (ext.xOff != font->ascii[pairs[i][0] - 0x20] + font->ascii[pairs[i][1] - 0x20])
+			return;
+	}
+	font->hasascii = 1;
+}
+
 /* This function is an implementation detail. Library users should use
  * drw_fontset_create instead.
  */
@@ -153,6 +894,7 @@ xfont_create(Drw *drw, const char *fontname, FcPattern *fontpattern)
 	font->pattern = pattern;
 	font->h = xfont->ascent + xfont->descent;
 	font->dpy = drw->dpy;
+	xfont_ascii(font);
 
 	return font;
 }
@@ -183,6 +925,11 @@ drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 			ret = cur;
 		}
 	}
+	/* a new set may reuse the address of a freed one */
+	extent_flush(drw);
+	coverage_flush(drw->coverage);
+	label_flush(drw);
+	atlas_flush(drw->atlas);
 	return (drw->fonts = ret);
 }
 
@@ -222,6 +969,8 @@ drw_scm_create(Drw *drw, const char *clrnames[], const unsigned int alphas[], si
 
 	for (i = 0; i < clrcount; i++)
 		drw_clr_create(drw, &ret[i], clrnames[i], alphas[i]);
+	/* labels are keyed on the address of their scheme */
+	label_flush(drw);
 	return ret;
 }
 
@@ -239,11 +988,68 @@ drw_setscheme(Drw *drw, Clr *scm)
 		drw->scheme = scm;
 }
 
+#ifdef XSHM
+static Bool
+isshmcompletion(Display *dpy, XEvent *ev, XPointer arg)
+{
+	return ev->type == ((Drw *)arg)->shmcompletion;
+}
+#endif /* XSHM */
+
+/* the server may still be reading the last put of img: carry on in the
+ * spare, brought up to date, instead of waiting for the completion */
+static void
+buf_swap(Drw *drw, Buf *buf)
+{
+	Image *im;
+#ifdef XSHM
+	XEvent ev;
+
+	/* both being read takes a server that fell behind */
+	while (buf->img->pending && (!buf->spare || buf->spare->pending)) {
+		XIfEvent(drw->dpy, &ev, isshmcompletion, (XPointer)drw);
+		drw_shmevent(drw, &ev);
+	}
+#endif /* XSHM */
+	if (!buf->img->pending)
+		return;
+	im = buf->spare;
+	image_copy(im, 0, 0, buf->img);
+	buf->spare = buf->img;
+	buf->img = im;
+}
+
+void
+drw_setbuf(Drw *drw, Buf *buf)
+{
+	if (drw && buf) {
+		if (buf->img && buf->img->pending)
+			buf_swap(drw, buf);
+		drw->drawable = buf->pixmap;
+		drw->xftdraw = buf->xftdraw;
+		drw->img = buf->img;
+	}
+}
+
 void
 drw_rect(Drw *drw, int x, int y, unsigned int w, unsigned int h, int filled, int invert)
 {
+	uint32_t px;
+
 	if (!drw || !drw->scheme)
 		return;
+	if (drw->img) {
+		px = invert ? drw->scheme[ColBg].pixel : drw->scheme[ColFg].pixel;
+		if (filled) {
+			image_fill(drw->img, x, y, w, h, px);
+		} else {
+			image_fill(drw->img, x, y, w, 1, px);
+			image_fill(drw->img, x, y + h - 1, w, 1, px);
+			image_fill(drw->img, x, y, 1, h, px);
+			image_fill(drw->img, x + w - 1, y, 1, h, px);
+		}
+		return;
+	}
 	XSetForeground(drw->dpy, drw->gc, invert ? drw->scheme[ColBg].pixel : drw->scheme[ColFg].pixel);
 	if (filled)
 		XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
@@ -251,133 +1057,306 @@ drw_rect(Drw *drw, int x, int y, unsigned int w, unsigned int h, int filled, int
 		XDrawRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w - 1, h - 1);
 }
 
+/* a font for a codepoint none of the set has, appended to the set */
+static Fnt *
+fallbackfont(Drw *drw, long utf8codepoint)
+{
+	Fnt *usedfont, *curfont;
+	FcCharSet *fccharset;
+	FcPattern *fcpattern;
+	FcPattern *match;
+	XftResult result;
+
+	fccharset = FcCharSetCreate();
+	FcCharSetAddChar(fccharset, utf8codepoint);
+
+	if (!drw->fonts->pattern) {
+		/* Refer to the comment in xfont_create for more information. */
+		die("the first font in the cache must be loaded from a font string.");
+	}
+
+	fcpattern = FcPatternDuplicate(drw->fonts->pattern);
+	FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
+	FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
+	FcPatternAddBool(fcpattern, FC_COLOR, FcFalse);
+
+	FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
+	FcDefaultSubstitute(fcpattern);
+	match = XftFontMatch(drw->dpy, drw->screen, fcpattern, &result);
+
+	FcCharSetDestroy(fccharset);
+	FcPatternDestroy(fcpattern);
+
+	usedfont = drw->fonts;
+	if (match) {
+		usedfont = xfont_create(drw, NULL, match);
+		if (usedfont && XftCharExists(drw->dpy, usedfont->xfont, utf8codepoint)) {
+			for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
+				; /* NOP */
+			curfont->next = usedfont;
+		} else {
+			xfont_free(usedfont);
+			usedfont = drw->fonts;
+		}
+	}
+	return usedfont;
+}
+
+/* the first font of the set having the codepoint, else a fallback font for it
+ * if fontconfig has one, else the first font; asked once per codepoint */
+static Fnt *
+fontfor(Drw *drw, long utf8codepoint)
+{
+	Fnt *curfont;
+	unsigned char *slot;
+	unsigned int i;
+
+	slot = coverage_slot(drw->coverage, utf8codepoint);
+	if (*slot == NOFONT)
+		return drw->fonts;
+	if (*slot) {
+		for (i = 1, curfont = drw->fonts; i < *slot; i++, curfont = curfont->next);
+		return curfont;
+	}
+
+	for (i = 1, curfont = drw->fonts; curfont; i++, curfont = curfont->next)
+		if (XftCharExists(drw->dpy, curfont->xfont, utf8codepoint))
+			break;
+	/* Regardless of whether or not a fallback font is found, the
+	 * character must be drawn. */
+	if (!curfont && (curfont = fallbackfont(drw, utf8codepoint)) == drw->fonts) {
+		*slot = NOFONT;
+		return curfont;
+	}
+	/* a fallback is appended, so its index is the length of the old set */
+	if (i < NOFONT)
+		*slot = i;
+	return curfont;
+}
+
+/* split text into runs of the font drawing each character and measure every
+ * character once */
+static Extent *
+extent_create(Drw *drw, const char *text, unsigned int hash)
+{
+	Extent *e;
+	Fnt *font;
+	TextRun *run = NULL;
+	const char *p;
+	size_t len = strlen(text), ascii = 0, clen, stretch, i;
+	long utf8codepoint = 0;
+	unsigned int n = 0, wsum = 0, ew = 0;
+
+	e = ecalloc(1, sizeof(Extent));
+	e->set = drw->fonts;
+	e->hash = hash;
+	e->text = ecalloc(len + 1, 1);
+	memcpy(e->text, text, len);
+	e->off = ecalloc(2 * (len + 1), sizeof(unsigned int));
+	e->adv = e->off + len + 1;
+	e->runs = ecalloc(len + 1, sizeof(TextRun));
+
+	for (p = text; *p; p += clen, ascii -= MIN(ascii, clen)) {
+		/* runs of 7-bit bytes need no decoding */
+		if (!ascii && !((unsigned char)*p & 0x80))
+			ascii = asciirun((const unsigned char *)p, text + len - p);
+		/* printable ones are all the first font's, and when its advance
+		 * table is exact a whole stretch of them is laid out in one go */
+		for (stretch = 0; drw->fonts->hasascii && stretch < ascii
+		     && BETWEEN(p[stretch], 0x20, 0x7e); stretch++);
+		if (stretch) {
+			clen = stretch;
+			font = drw->fonts;
+		} else if (ascii) {
+			clen = 1;
+			utf8codepoint = (unsigned char)*p;
+			font = fontfor(drw, utf8codepoint);
+		} else {
+			clen = utf8decode(p, &utf8codepoint, UTF_SIZ);
+			font = fontfor(drw, utf8codepoint);
+		}
+		if (!run || run->font != font) {
+			if (run)
+				run->end = n;
+			run = &e->runs[e->nruns++];
+			run->font = font;
+			run->start = n;
+		}
+		if (stretch) {
+			for (i = 0; i < stretch; i++, n++) {
+				e->off[n] = p + i - text;
+				e->adv[n] = wsum;
+				wsum += font->ascii[p[i] - 0x20];
+			}
+		} else {
+			drw_font_getexts(font, p, clen, &ew, NULL);
+			e->off[n] = p - text;
+			e->adv[n++] = wsum;
+			wsum += ew;
+		}
+	}
+	if (run)
+		run->end = n;
+	e->off[n] = p - text;
+	e->adv[n] = wsum;
+	e->nchars = n;
+	return e;
+}
+
+/* the cached layout of text in the current fontset */
+static Extent *
+extent_get(Drw *drw, const char *text)
+{
+	Extent *e;
+	unsigned int hash = 2166136261u;
+	const char *s;
+
+	for (s = text; *s; s++)
+		hash = (hash ^ (unsigned char)*s) * 16777619u;
+	for (e = drw->extents[hash & (EXTENTHASH - 1)]; e; e = e->hnext)
+		if (e->hash == hash && e->set == drw->fonts && !strcmp(e->text, text))
+			break;
+	if (e) {
+		if (e == drw->lru)
+			return e;
+		e->prev->next = e->next;
+		e->next->prev = e->prev;
+	} else {
+		if (drw->nextents == EXTENTMAX)
+			extent_free(drw, drw->lru->prev);
+		e = extent_create(drw, text, hash);
+		e->hnext = drw->extents[hash & (EXTENTHASH - 1)];
+		drw->extents[hash & (EXTENTHASH - 1)] = e;
+		drw->nextents++;
+	}
+	if (drw->lru) {
+		e->next = drw->lru;
+		e->prev = drw->lru->prev;
+		e->prev->next = e;
+		e->next->prev = e;
+	} else {
+		e->next = e->prev = e;
+	}
+	return (drw->lru = e);
+}
+
 int
 drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
 {
 	char buf[1024];
 	int ty;
-	unsigned int ew;
-	XftDraw *d = NULL;
-	Fnt *usedfont, *curfont, *nextfont;
+	unsigned int ew, base, lo, hi, mid, r;
+	Extent *e;
+	TextRun *run;
 	size_t i, len;
-	int utf8strlen, utf8charlen, render = x || y || w || h;
-	long utf8codepoint = 0;
-	const char *utf8str;
-	FcCharSet *fccharset;
-	FcPattern *fcpattern;
-	FcPattern *match;
-	XftResult result;
-	int charexists = 0;
+	int render = x || y || w || h;
 
 	if (!drw || (render && !drw->scheme) || !text || !drw->fonts)
 		return 0;
 
-	if (!render) {
-		w = ~w;
+	e = extent_get(drw, text);
+	if (!render)
+		return e->adv[e->nchars];
+
+	if (drw->img) {
+		image_fill(drw->img, x, y, w, h, drw->scheme[invert ? ColFg : ColBg].pixel);
 	} else {
 		XSetForeground(drw->dpy, drw->gc, drw->scheme[invert ? ColFg : ColBg].pixel);
 		XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
-		d = XftDrawCreate(drw->dpy, drw->drawable, drw->visual, drw->cmap);
-		x += lpad;
-		w -= lpad;
 	}
+	x += lpad;
+	w -= lpad;
 
-	usedfont = drw->fonts;
-	while (1) {
-		utf8strlen = 0;
-		utf8str = text;
-		nextfont = NULL;
-		while (*text) {
-			utf8charlen = utf8decode(text, &utf8codepoint, UTF_SIZ);
-			for (curfont = drw->fonts; curfont; curfont = curfont->next) {
-				charexists = charexists || XftCharExists(drw->dpy, curfont->xfont, utf8codepoint);
-				if (charexists) {
-					if (curfont == usedfont) {
-						utf8strlen += utf8charlen;
-						text += utf8charlen;
-					} else {
-						nextfont = curfont;
-					}
-					break;
-				}
-			}
-
-			if (!charexists || nextfont)
-				break;
+	for (r = 0; r < e->nruns; r++) {
+		run = &e->runs[r];
+		base = e->adv[run->start];
+		/* shorten text if necessary: the longest prefix of the run that fits */
+		for (lo = run->start, hi = run->end; lo < hi;) {
+			mid = (lo + hi + 1) / 2;
+			if (e->adv[mid] - base <= w && e->off[mid] - e->off[run->start] < sizeof(buf))
+				lo = mid;
 			else
-				charexists = 0;
+				hi = mid - 1;
 		}
+		len = e->off[lo] - e->off[run->start];
+		ew = e->adv[lo] - base;
 
-		if (utf8strlen) {
-			drw_font_getexts(usedfont, utf8str, utf8strlen, &ew, NULL);
-			/* shorten text if necessary */
-			for (len = MIN(utf8strlen, sizeof(buf) - 1); len && ew > w; len--)
-				drw_font_getexts(usedfont, utf8str, len, &ew, NULL);
-
-			if (len) {
-				memcpy(buf, utf8str, len);
-				buf[len] = '\0';
-				if (len < utf8strlen)
-					for (i = len; i && i > len - 3; buf[--i] = '.')
-						; /* NOP */
-
-				if (render) {
-					ty = y + (h - usedfont->h) / 2 + usedfont->xfont->ascent;
-					XftDrawStringUtf8(d, &drw->scheme[invert ? ColBg : ColFg],
-					                  usedfont->xfont, x, ty, (XftChar8 *)buf, len);
-				}
-				x += ew;
-				w -= ew;
-			}
+		if (len) {
+			memcpy(buf, e->text + e->off[run->start], len);
+			buf[len] = '\0';
+			if (lo < run->end)
+				for (i = len; i && i > len - 3; buf[--i] = '.')
+					; /* NOP */
+
+			ty = y + (h - run->font->h) / 2 + run->font->xfont->ascent;
+#ifdef XSHM
+			if (drw->img)
+				image_string(drw, run->font, e, run->start, lo, x, ty, buf,
+				             lo < run->end ? MIN(len, 3) : 0,
+				             drw->scheme[invert ? ColBg : ColFg].pixel);
+			else
+#endif /* XSHM */
+				XftDrawStringUtf8(drw->xftdraw, &drw->scheme[invert ? ColBg : ColFg],
+				                  run->font->xfont, x, ty, (XftChar8 *)buf, len);
+			x += ew;
+			w -= ew;
 		}
+	}
 
-		if (!*text) {
-			break;
-		} else if (nextfont) {
-			charexists = 0;
-			usedfont = nextfont;
-		} else {
-			/* Regardless of whether or not a fallback font is found, the
-			 * character must be drawn. */
-			charexists = 1;
+	return x + w;
+}
 
-			fccharset = FcCharSetCreate();
-			FcCharSetAddChar(fccharset, utf8codepoint);
+/* drw_text() for labels that are drawn over and over: the first time into a
+ * buffer of their own, after that it is only copied */
+int
+drw_label(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
+{
+	Label *l, *lru = NULL;
+	Drawable drawable;
+	XftDraw *xftdraw;
+	Image *img;
+	unsigned int i;
 
-			if (!drw->fonts->pattern) {
-				/* Refer to the comment in xfont_create for more information. */
-				die("the first font in the cache must be loaded from a font string.");
-			}
+	if (!drw || !drw->scheme || !text || !drw->fonts || !w || !h
+	|| strlen(text) >= sizeof(lru->text))
+		return drw_text(drw, x, y, w, h, lpad, text, invert);
 
-			fcpattern = FcPatternDuplicate(drw->fonts->pattern);
-			FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
-			FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
-			FcPatternAddBool(fcpattern, FC_COLOR, FcFalse);
-
-			FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
-			FcDefaultSubstitute(fcpattern);
-			match = XftFontMatch(drw->dpy, drw->screen, fcpattern, &result);
-
-			FcCharSetDestroy(fccharset);
-			FcPatternDestroy(fcpattern);
-
-			if (match) {
-				usedfont = xfont_create(drw, NULL, match);
-				if (usedfont && XftCharExists(drw->dpy, usedfont->xfont, utf8codepoint)) {
-					for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
-						; /* NOP */
-					curfont->next = usedfont;
-				} else {
-					xfont_free(usedfont);
-					usedfont = drw->fonts;
-				}
-			}
-		}
+	for (i = 0; i < LABELMAX; i++) {
+		l = &drw->labels[i];
+		if (l->buf && l->set == drw->fonts && l->scheme == drw->scheme && l->invert == invert
+		&& l->w == w && l->h == h && l->lpad == lpad && !strcmp(l->text, text))
+			break;
+		if (!lru || (lru->buf && (!l->buf || l->used < lru->used)))
+			lru = l;
+	}
+	if (i == LABELMAX) {
+		l = lru;
+		drw_buf_free(drw, l->buf);
+		strcpy(l->text, text);
+		l->set = drw->fonts;
+		l->scheme = drw->scheme;
+		l->invert = invert;
+		l->w = w;
+		l->h = h;
+		l->lpad = lpad;
+		/* never put on a window itself, so it need not be shared */
+		l->buf = buf_create(drw, w, h, 0);
+		drawable = drw->drawable;
+		xftdraw = drw->xftdraw;
+		img = drw->img;
+		drw_setbuf(drw, l->buf);
+		drw_text(drw, 0, 0, w, h, lpad, text, invert);
+		drw->drawable = drawable;
+		drw->xftdraw = xftdraw;
+		drw->img = img;
 	}
-	if (d)
-		XftDrawDestroy(d);
+	l->used = ++drw->labelclock;
+	if (drw->img)
+		image_copy(drw->img, x, y, l->buf->img);
+	else
+		XCopyArea(drw->dpy, l->buf->pixmap, drw->drawable, drw->gc, 0, 0, w, h, x, y);
 
-	return x + (render ? w : 0);
+	return x + w;
 }
 
 void
@@ -386,8 +1365,36 @@ drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 	if (!drw)
 		return;
 
-	XCopyArea(drw->dpy, drw->drawable, win, drw->gc, x, y, w, h, x, y);
-	XSync(drw->dpy, False);
+	if (!drw->img) {
+		XCopyArea(drw->dpy, drw->drawable, win, drw->gc, x, y, w, h, x, y);
+		return;
+	}
+#ifdef XSHM
+	if (drw->img->shm.shmid != -1) {
+		XShmPutImage(drw->dpy, win, drw->gc, drw->img->ximg, x, y, x, y, w, h, True);
+		drw->img->pending = 1;
+		return;
+	}
+#endif /* XSHM */
+	XPutImage(drw->dpy, win, drw->gc, drw->img->ximg, x, y, x, y, w, h);
+}
+
+/* whether ev is the completion of a drw_map(), which the caller can drop */
+int
+drw_shmevent(Drw *drw, XEvent *ev)
+{
+#ifdef XSHM
+	Image *im;
+
+	if (!drw || !drw->shmcompletion || ev->type != drw->shmcompletion)
+		return 0;
+	for (im = drw->images; im; im = im->next)
+		if (im->shm.shmseg == ((XShmCompletionEvent *)ev)->shmseg)
+			im->pending = 0;
+	return 1;
+#else
+	return 0;
+#endif /* XSHM */
 }
 
 unsigned int
@@ -402,10 +1409,22 @@ void
 drw_font_getexts(Fnt *font, const char *text, unsigned int len, unsigned int *w, unsigned int *h)
 {
 	XGlyphInfo ext;
+	unsigned int i, sum = 0;
 
 	if (!font || !text)
 		return;
 
+	if (font->hasascii) {
+		for (i = 0; i < len && BETWEEN(text[i], 0x20, 0x7e); i++)
+			sum += font->ascii[text[i] - 0x20];
+		if (i == len) {
+			if (w)
+				*w = sum;
+			if (h)
+				*h = font->h;
+			return;
+		}
+	}
 	XftTextExtentsUtf8(font->dpy, font->xfont, (XftChar8 *)text, len, &ext);
 	if (w)
 		*w = ext.xOff;
@@ -9,12 +9,30 @@ typedef struct Fnt {
 	unsigned int h;
 	XftFont *xfont;
 	FcPattern *pattern;
+	int hasascii;                      /* ascii[] is exact for this font */
+	unsigned short ascii[0x7f - 0x20]; /* advances of printable ASCII */
 	struct Fnt *next;
 } Fnt;
 
 enum { ColFg, ColBg, ColBorder }; /* Clr scheme index */
 typedef XftColor Clr;
 
+typedef struct Image Image;
+
+/* an offscreen surface drawn to once and copied out as often as needed */
+typedef struct {
+	unsigned int w, h;
+	Pixmap pixmap;
+	XftDraw *xftdraw;
+	Image *img;  /* client-side pixels instead, with MIT-SHM */
+	Image *spare; /* the other of a pair put on a window, see drw_setbuf() */
+} Buf;
+
+typedef struct Atlas Atlas;
+typedef struct Extent Extent;
+typedef struct Coverage Coverage;
+typedef struct Label Label;
+
 typedef struct {
 	unsigned int w, h;
 	Display *dpy;
@@ -23,16 +41,30 @@ typedef struct {
 	Visual *visual;
 	unsigned int depth;
 	Colormap cmap;
-	Drawable drawable;
+	Drawable drawable;  /* the current buffer's pixmap */
+	XftDraw *xftdraw;
+	Image *img;         /* or its pixels, when rasterizing client-side */
+	Buf *own;           /* the buffer of drw_create()/drw_resize() */
 	GC gc;
 	Clr *scheme;
 	Fnt *fonts;
+	Extent **extents;  /* measured strings, hashed on the text */
+	Extent *lru;       /* most recently used first, circular */
+	unsigned int nextents;
+	Coverage *coverage;  /* which font of the set draws each codepoint */
+	Label *labels;       /* pre-rendered drw_label() text */
+	unsigned long labelclock;
+	int shmcompletion;   /* event type of ShmCompletion, 0 drawing through Xft */
+	Image *images;       /* shared images, to match completions */
+	Atlas *atlas;        /* rasterized glyphs */
 } Drw;
 
 /* Drawable abstraction */
 Drw *drw_create(Display *dpy, int screen, Window win, unsigned int w, unsigned int h, Visual *visual, unsigned int depth, Colormap cmap);
 void drw_resize(Drw *drw, unsigned int w, unsigned int h);
 void drw_free(Drw *drw);
+Buf *drw_buf_create(Drw *drw, unsigned int w, unsigned int h);
+void drw_buf_free(Drw *drw, Buf *buf);
 
 /* Fnt abstraction */
 Fnt *drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount);
@@ -51,12 +83,15 @@ void drw_cur_free(Drw *drw, Cur *cursor);
 /* Drawing context manipulation */
 void drw_setfontset(Drw *drw, Fnt *set);
 void drw_setscheme(Drw *drw, Clr *scm);
+void drw_setbuf(Drw *drw, Buf *buf);
 
 /* Drawing functions */
 void drw_rect(Drw *drw, int x, int y, unsigned int w, unsigned int h, int filled, int invert);
 int drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert);
+int drw_label(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert);
 
 /* Map functions */
 void drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h);
+int drw_shmevent(Drw *drw, XEvent *ev);
 
 /* vim: set noexpandtab: */
@@ -25,9 +25,12 @@
 #pragma GCC diagnostic ignored "-Wunused-variable"
 #pragma GCC diagnostic ignored "-Wunused-result"
 #pragma GCC diagnostic ignored "-Wint-conversion"
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <math.h>
 #include <locale.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -37,12 +40,19 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xproto.h>
 #include <X11/Xutil.h>
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif /* XRANDR */
 #ifdef XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
@@ -78,9 +88,24 @@
 
 
 #define OPAQUE                  0xffU
+#define EASESTEPS               256
+#define FRAMENS                 15000000 /* nominal frame tween lengths are given in */
+#define TRANSITIONFRAMES        7
+#define EVBATCH                 128
+#define BARREGIONS              48   /* tags, layout symbol, title and status */
+#define STATUSSEGS              16   /* named status segments */
+#define STATUSSCHEMES           16   /* colors status segments asked for */
+#define PROCHASHSIZE            256  /* power of two */
+#define PROCMAX                 512  /* processes whose parent is cached, LRU */
+#define PROCHASH(P)             ((unsigned)(P) & (PROCHASHSIZE - 1))
+#define PREFETCHMAX             64   /* windows prefetched ahead of MapRequest */
+#define TEXTPROPLEN             1024 /* 32-bit units read of a text property */
+#define WINHASHSIZE             512 /* power of two */
+#define WINHASH(W)              (((W) ^ ((W) >> 21)) & (WINHASHSIZE - 1))
 
 /* enums */
 enum { CurNormal, CurResize, CurMove, CurLast }; /* cursor */
+enum { DirtyArrange = 1, DirtyRestack = 2, DirtyBar = 4, DirtyStatus = 8 }; /* pending for commit() */
 enum { SchemeNorm, SchemeSel }; /* color schemes */
 enum { NetSupported, NetWMName, NetWMState, NetWMCheck,
        NetWMFullscreen, NetActiveWindow, NetWMWindowType,
@@ -118,7 +143,27 @@ typedef struct {
 } Button;
 
 typedef struct Monitor Monitor;
+
+/* where a part of the bar starts, as it was last drawn; it ends where the
+ * next one starts */
+typedef struct {
+	int x;
+	unsigned int click;
+	unsigned int arg;
+} BarRegion;
 typedef struct Client Client;
+
+typedef struct {
+	int ox, oy, ow, oh;   /* geometry the tween starts from */
+	int tx, ty, tw, th;   /* geometry the tween eases towards */
+	int fx, fy, fw, fh;   /* geometry committed once the tween ends */
+	int frames;           /* length in FRAMENS, 0 means no tween in flight */
+	long long start;      /* CLOCK_MONOTONIC ns it began, 0 lands it next tick */
+	int resetpos;
+	int ghost;            /* only the window moves, hidden when done */
+	void (*done)(Client *c);
+} Anim;
+
 struct Client {
 	char name[256];
 	float mina, maxa;
@@ -136,6 +181,18 @@ struct Client {
 	Client *swallowing;
 	Window win;
 	ClientState prevstate;
+	/* as last put in the IPC change log, lastwin is None until then */
+	Window lastwin;
+	int lastmon;
+	unsigned int lasttags;
+	Anim anim;
+	int cx, cy, cw, ch, cbw;   /* geometry last sent to the server */
+	int dropin;                /* play the map animation after the next arrange */
+	Client *hnext;             /* wintab chain, by win */
+	Client *swnext;            /* swaltab chain, by swallowing->win */
+	Client *tnext;             /* termtab chain, by pid */
+	int queued;
+	Client *qnext;             /* geometry commit queue */
 };
 
 typedef struct {
@@ -152,6 +209,7 @@ typedef struct {
 } Layout;
 
 typedef struct Pertag Pertag;
+typedef struct Matcher Matcher;
 struct Monitor {
 	char ltsymbol[16];
 	char lastltsymbol[16];
@@ -172,12 +230,20 @@ struct Monitor {
   TagState tagstate;
 	int showbar;
 	int topbar;
+	int slide;            /* direction the next arrange slides clients in from */
+	int dirty;            /* Dirty* work left for commit() */
+	long framens;         /* refresh period, paces tweens and pointer drags */
+	int clockfd;          /* frame clock, armed while a tween is in flight */
+	int clockarmed;
 	Client *clients;
 	Client *sel;
 	Client *lastsel;
 	Client *stack;
 	Monitor *next;
 	Window barwin;
+	Buf *barbuf;          /* the bar as last drawn, for exposes */
+	BarRegion regions[BARREGIONS];
+	int nregions;
 	Window traywin;
 	const Layout *lt[2];
 	Pertag *pertag;
@@ -206,8 +272,76 @@ typedef struct {
 	int topbar;
 } MonitorRule;
 
+/* a piece of the status set through the status socket */
+typedef struct {
+	char name[32];
+	char text[256];
+	Clr *scheme;
+	int x, w;   /* where it was last drawn, on statusmon */
+	int dirty;  /* changed, but not its width */
+	unsigned int id;  /* never reused, what bar regions know it by */
+} Segment;
+
+typedef struct {
+	char fg[8], bg[8];
+	Clr *scheme;
+} StatusScheme;
+
+typedef struct {
+	int tfd, fd;             /* its timer, and the file it reads */
+	unsigned long long a, b; /* kept between ticks */
+} ModState;
+
+typedef struct {
+	const char *name;
+	int (*func)(const char *arg, ModState *st, char *text, size_t size);
+	const char *arg;
+	unsigned int interval;
+} Module;
+
+/* a process whose parent is known, forgotten when its pidfd says it exited */
+typedef struct Proc Proc;
+struct Proc {
+	pid_t pid, ppid;
+	int fd;
+	Proc *next;         /* same bucket of proctab */
+	Proc *sibling;      /* same bucket of prockids */
+	Proc *fdnext;       /* same bucket of procfds */
+	Proc *newer, *older;
+	int stale;          /* parent exited, ppid is to be read again */
+};
+
+/* everything manage() reads from a window, requested in one go */
+typedef struct {
+	xcb_get_window_attributes_cookie_t attrs;
+	xcb_get_geometry_cookie_t geom;
+	xcb_get_property_cookie_t netname, name, trans, class, state, wtype, normalhints, hints;
+	xcb_res_query_client_ids_cookie_t pid;
+} PropCookies;
+
+typedef struct {
+	int ok;                /* the window still exists */
+	XWindowAttributes wa;  /* geometry, border, map state, override_redirect */
+	char name[256];
+	char class[256], instance[256];
+	int hastrans;
+	Window trans;
+	pid_t pid;
+	Atom state, wtype;     /* first atom of each */
+	int hassize, haswmh;
+	XSizeHints size;
+	XWMHints wmh;
+} Props;
+
 /* function declarations */
-static void applyrules(Client *c);
+static void applyrules(Client *c, const Props *p);
+static void compilerules(void);
+static void matchrules(const char *class, const char *instance, const char *title, unsigned long *bits);
+static void acadd(Matcher *a, const char *pat, int rule);
+static void aclink(Matcher *a);
+static void acmatch(const Matcher *a, const char *s, unsigned long *bits);
+static int acstep(const Matcher *a, int n, unsigned char ch);
+static void freerules(void);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 static void arrange(Monitor *m);
 static void togglemaximize(const Arg *arg);
@@ -215,26 +349,50 @@ static void arrangemon(Monitor *m);
 static void attach(Client *c);
 static void attachaside(Client *c);
 static void attachstack(Client *c);
+static void attachhash(Client *c);
+static void attachswallow(Client *p);
 static void bstack(Monitor *m);
 static void bstackhoriz(Monitor *m);
 static void buttonpress(XEvent *e);
 static void checkotherwm(void);
 static void cleanup(void);
 static void cleanupmon(Monitor *mon);
+static void collectprops(PropCookies *ck, Props *p);
 static void clientmessage(XEvent *e);
+static void commit(void);
+static void commitfocus(void);
 static void configure(Client *c);
 static void configurenotify(XEvent *e);
 static void configurerequest(XEvent *e);
 static Monitor *createmon(void);
+static void createnotify(XEvent *e);
 static void cyclelayout(const Arg *arg);
 static void destroynotify(XEvent *e);
 static void detach(Client *c);
 static void detachstack(Client *c);
-static void detachstack(Client *c);
+static void detachhash(Client *c);
+static void detachswallow(Client *p);
 static void redrawwin(const Arg *arg);
 static Monitor *dirtomon(int dir);
 static void drawbar(Monitor *m);
+static void drawbarmon(Monitor *m);
+static void drawstatusmon(Monitor *m);
+static void handlestatus(void);
+static void statusinit(void);
+static void statusmsg(char *msg);
+static void setsegment(const char *name, Clr *scm, const char *text);
+static int modbattery(const char *arg, ModState *st, char *text, size_t size);
+static int modclock(const char *arg, ModState *st, char *text, size_t size);
+static int modcpu(const char *arg, ModState *st, char *text, size_t size);
+static int modmem(const char *arg, ModState *st, char *text, size_t size);
+static void modarm(ModState *st, unsigned int interval);
+static void modulesinit(void);
+static ssize_t modread(const char *path, ModState *st, char *buf, size_t size);
+static int modtick(int fd);
+static Clr *statusscheme(const char *fg, const char *bg);
+static void barregion(Monitor *m, int x, unsigned int click, unsigned int arg);
 static void drawbars(void);
+static void dropin(Client *c);
 static void enternotify(XEvent *e);
 static void expose(XEvent *e);
 static void focus(Client *c);
@@ -243,15 +401,26 @@ static void focusmon(const Arg *arg);
 static void focusstack(const Arg *arg);
 static int getrootptr(int *x, int *y);
 static long getstate(Window w);
+static void getprops(Window w, Props *p);
 static int gettextprop(Window w, Atom atom, char *text, unsigned int size);
 static void grabbuttons(Client *c, int focused);
 static void grabkeys(void);
+static Monitor *clocktomon(int fd);
+static void handleclock(Monitor *m);
+static void coalesce(void);
+static void dispatch(XEvent *ev);
+static void dropbatched(int type);
 static int handlexevent(struct epoll_event *ev);
+static void handlexqueue(void);
+static Window evwindow(XEvent *ev);
+static int sameevent(XEvent *a, XEvent *b);
 static void incnmaster(const Arg *arg);
 static void keypress(XEvent *e);
 static void killclient(const Arg *arg);
+static void killwin(Client *c);
+static void hidewin(Client *c);
 static void killunsel(const Arg *arg);
-static void manage(Window w, XWindowAttributes *wa);
+static void manage(Window w, const Props *p);
 static void managealtbar(Window win, XWindowAttributes *wa);
 static void managetray(Window win, XWindowAttributes *wa);
 static void mappingnotify(XEvent *e);
@@ -261,8 +430,14 @@ static void motionnotify(XEvent *e);
 static void movemouse(const Arg *arg);
 static Client *nexttagged(Client *c);
 static Client *nexttiled(Client *c);
+static long long nowns(void);
 static void pop(Client *);
 static Client *prevtiled(Client *c);
+static void prefetch(Window w);
+static void prefetchdrop(Window w);
+static int prefetchindex(Window w);
+static void prefetchrefresh(Window w, Atom a);
+static int prefetchtake(Window w, Props *p);
 static void propertynotify(XEvent *e);
 static void pushdown(const Arg *arg);
 static void pushstack(const Arg *arg);
@@ -273,8 +448,10 @@ static void resize(Client *c, int x, int y, int w, int h, int interact);
 static void resizeclient(Client *c, int x, int y, int w, int h);
 static void resizemouse(const Arg *arg);
 static void restack(Monitor *m);
+static void restackmon(Monitor *m);
 static void run(void);
 static void runAutostart(void);
+static void requestprops(Window w, PropCookies *ck);
 static void scan(void);
 static void scantray(void);
 static int sendevent(Client *c, Atom proto);
@@ -282,6 +459,10 @@ static void sendmon(Client *c, Monitor *m);
 static void setclientstate(Client *c, long state);
 static void setfocus(Client *c);
 static void setfullscreen(Client *c, int fullscreen);
+static void setsizehints(Client *c, const XSizeHints *size);
+static void settitle(Client *c, const char *name);
+static void setwindowtype(Client *c, Atom state, Atom wtype);
+static void setwmhints(Client *c, XWMHints *wmh);
 static void setgaps(int oh, int ov, int ih, int iv);
 static void incrgaps(const Arg *arg);
 static void incrigaps(const Arg *arg);
@@ -326,6 +507,7 @@ static void updatebars(void);
 static void updateclientlist(void);
 static int updategeom(void);
 static void updatenumlockmask(void);
+static void updaterefresh(void);
 static void updatesizehints(Client *c);
 static void updatestatus(void);
 static void updategapstatus(void);
@@ -334,6 +516,20 @@ static void updatewindowtype(Client *c);
 static void updatewmhints(Client *c);
 static void view(const Arg *arg);
 static void warp(const Client *c);
+static void animate(Client *c, int x, int y, int w, int h, int frames, int resetpos, void (*done)(Client *));
+static void animateclient(Client *c, int x, int y, int w, int h, int frames, int resetpos);
+static int animarm(Monitor *m);
+static void dequeuegeom(Client *c);
+static void flushgeom(void);
+static void movewin(Client *c, int x, int y);
+static void moveresizewin(Client *c, int x, int y, int w, int h);
+static Client *animdue(Monitor *m, long long now);
+static void animfinish(Client *c);
+static void animlayout(Client *c, int x, int y, int w, int h);
+static void animretarget(Client *c, int x, int y, int w, int h);
+static void animslideout(Monitor *m, int dir);
+static void animstep(Client *c, long long now);
+static void animtick(Monitor *m);
 static void animleft(const Arg *arg);
 static void animright(const Arg *arg);
 static Client *wintoclient(Window w);
@@ -349,20 +545,38 @@ static void centeredfloatingmaster(Monitor *m);
 
 static pid_t getparentprocess(pid_t p);
 static int isdescprocess(pid_t p, pid_t c);
+static void attachterm(Client *c);
+static void detachterm(Client *c);
+static int procevict(Proc *p);
+static void procbury(void);
+static int procexited(int fd);
+static pid_t procparent(pid_t pid);
 static Client *swallowingclient(Window w);
 static Client *termforwin(const Client *c);
+static pid_t replypid(xcb_res_query_client_ids_cookie_t ck);
+static int textprop(xcb_get_property_reply_t *r, char *text, unsigned int size);
 static pid_t winpid(Window w);
 
 /* variables */
 static const char broken[] = "broken";
 static char stext[16];
+static Segment segs[STATUSSEGS];
+static unsigned int nsegs, lastsegid;
+static StatusScheme statusschemes[STATUSSCHEMES];
+static unsigned int nstatusschemes;
+static int status_fd = -1;
+static Monitor *statusmon;  /* whose bar shows the segments */
+static int statusmin;       /* left of this they are overdrawn by the tags */
 static char gtext[16];
 static int screen;
 static int sw, sh;           /* X display screen geometry width, height */
 static int bh, blw = 0;      /* bar geometry */
 static int enablegaps = 1;
 static int lrpad;            /* sum of left and right padding for text */
-static int xfps = 60;
+static int xfps = 60;        /* refresh rate assumed when RandR can't tell */
+#ifdef XRANDR
+static int randr, rrevbase;
+#endif /* XRANDR */
 static int (*xerrorxlib)(Display *, XErrorEvent *);
 static unsigned int numlockmask = 0;
 static void (*handler[LASTEvent]) (XEvent *) = {
@@ -370,6 +584,7 @@ static void (*handler[LASTEvent]) (XEvent *) = {
 	[ClientMessage] = clientmessage,
 	[ConfigureRequest] = configurerequest,
 	[ConfigureNotify] = configurenotify,
+	[CreateNotify] = createnotify,
 	[DestroyNotify] = destroynotify,
 	[EnterNotify] = enternotify,
 	[Expose] = expose,
@@ -387,6 +602,27 @@ Bool realfullscreen = 0;
 static Atom wmatom[WMLast], netatom[NetLast];
 static int epoll_fd;
 static int dpy_fd;
+static int transition = 0;   /* resize() eases layout moves while set */
+static Client *geomq = NULL;  /* clients whose geometry awaits flushgeom() */
+static int focusdirty = 0;    /* selmon->sel awaits commitfocus() */
+static Client *xfocus = NULL; /* client the server has focused */
+static Client *wintab[WINHASHSIZE];  /* managed clients by window */
+static Client *swaltab[WINHASHSIZE]; /* swallowing clients by swallowed window */
+static Proc *proctab[PROCHASHSIZE];  /* pid -> parent pid */
+static Proc *prockids[PROCHASHSIZE]; /* by parent pid */
+static Proc *procfds[PROCHASHSIZE];  /* by pidfd */
+static Proc *procnewest, *procoldest; /* by last use */
+static int nproc;
+static int procgraves[PROCMAX]; /* evicted pidfds, closed between batches */
+static int nprocgraves;
+static Client *termtab[PROCHASHSIZE]; /* terminal clients by pid */
+static Window prefetchwin[PREFETCHMAX];      /* oldest first */
+static PropCookies prefetchck[PREFETCHMAX];
+static int nprefetch;
+static XEvent evbatch[EVBATCH]; /* drained from Xlib, coalesced, then dispatched */
+static int evbatchn, evbatchi;
+static unsigned long evseen[LASTEvent], evcollapsed[LASTEvent];
+static double easetab[EASESTEPS + 1];
 static int running = 1;
 static int restart = 0;
 static Cur *cursor[CurLast];
@@ -407,13 +643,13 @@ static Colormap cmap;
 
 /* configuration, allows nested code to access above variables */
 
-//#include "ipc.h"
+#include "ipc.h"
 #include "config.h"
 
 #ifdef VERSION
-/*#include "IPCClient.c"
+#include "IPCClient.c"
 #include "yajl_dumps.c"
-#include "ipc.c"*/
+#include "ipc.c"
 #endif
 
 
@@ -428,32 +664,64 @@ struct Pertag {
 	Client *prevzooms[LENGTH(tags) + 1]; /* store zoom information */
 };
 
+/* rules[] compiled into one Aho-Corasick automaton per field; matching a
+ * string sets the bit of every rule whose pattern occurs in it */
+#define RULEBITS                (sizeof(unsigned long) * 8)
+#define RULEWORDS               ((LENGTH(rules) + RULEBITS - 1) / RULEBITS)
+#define RULEMEMOSIZE            64   /* power of two */
+
+typedef struct {
+	int child, sibling;  /* trie edges */
+	int fail;            /* longest proper suffix that is also in the trie */
+	int out;             /* nearest node on the fail chain ending a pattern */
+	int rule;            /* first rule whose pattern ends here, or -1 */
+	unsigned char ch;
+} ACNode;
+
+struct Matcher {
+	ACNode *node;
+	int n, size;
+	int root[256];                /* goto from the root, dense */
+	int rulenext[LENGTH(rules)];  /* further rules sharing a pattern */
+	unsigned long any[RULEWORDS]; /* rules without a criterion here */
+	int used;                     /* some rule has a criterion here */
+};
+
+/* class and instance matches, reused until the window pair changes; the
+ * strings are sized as in Props so none is ever truncated */
+typedef struct {
+	int valid;
+	char class[256], instance[256];
+	unsigned long bits[RULEWORDS];
+} RuleMemo;
+
+static Matcher classmatch, instancematch, titlematch;
+static RuleMemo rulememo[RULEMEMOSIZE];
+static ModState modstate[LENGTH(modules)];
+
 /* compile-time check if all tags fit into an unsigned int bit array. */
 struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 
 /* function implementations */
 void
-applyrules(Client *c)
+applyrules(Client *c, const Props *p)
 {
 	const char *class, *instance;
+	unsigned long bits[RULEWORDS];
 	unsigned int i;
 	const Rule *r;
 	Monitor *m;
-	XClassHint ch = { NULL, NULL };
 
 	/* rule matching */
 	c->isfloating = 0;
 	c->tags = 0;
-	XGetClassHint(dpy, c->win, &ch);
-	class    = ch.res_class ? ch.res_class : broken;
-	instance = ch.res_name  ? ch.res_name  : broken;
+	class    = p->class[0] ? p->class : broken;
+	instance = p->instance[0] ? p->instance : broken;
+	matchrules(class, instance, c->name, bits);
 
 	for (i = 0; i < LENGTH(rules); i++) {
-		r = &rules[i];
-		if ((!r->title || strstr(c->name, r->title))
-		&& (!r->class || strstr(class, r->class))
-		&& (!r->instance || strstr(instance, r->instance)))
-		{
+		if (bits[i / RULEBITS] & 1UL << (i % RULEBITS)) {
+			r = &rules[i];
 			c->isterminal = r->isterminal;
 			c->noswallow  = r->noswallow;
 			c->iscentered = r->iscentered;
@@ -469,13 +737,160 @@ applyrules(Client *c)
 				c->mon = m;
 		}
 	}
-	if (ch.res_class)
-		XFree(ch.res_class);
-	if (ch.res_name)
-		XFree(ch.res_name);
 	c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : (c->mon->tagset[c->mon->seltags] & ~SPTAGMASK);
 }
 
+int
+acstep(const Matcher *a, int n, unsigned char ch)
+{
+	int k;
+
+	for (; n; n = a->node[n].fail)
+		for (k = a->node[n].child; k; k = a->node[k].sibling)
+			if (a->node[k].ch == ch)
+				return k;
+	return a->root[ch];
+}
+
+void
+acadd(Matcher *a, const char *pat, int rule)
+{
+	int n = 0, k;
+
+	if (!pat || !*pat) {
+		/* strstr() finds the empty pattern everywhere */
+		a->any[rule / RULEBITS] |= 1UL << (rule % RULEBITS);
+		return;
+	}
+	a->used = 1;
+	for (; *pat; pat++, n = k) {
+		if (n)
+			for (k = a->node[n].child; k && a->node[k].ch != (unsigned char)*pat;
+			     k = a->node[k].sibling);
+		else
+			k = a->root[(unsigned char)*pat];
+		if (k)
+			continue;
+		if (a->n == a->size) {
+			a->size = a->size ? a->size * 2 : 64;
+			if (!(a->node = realloc(a->node, a->size * sizeof(ACNode))))
+				die("realloc:");
+		}
+		k = a->n++;
+		memset(&a->node[k], 0, sizeof(ACNode));
+		a->node[k].rule = -1;
+		a->node[k].ch = (unsigned char)*pat;
+		if (n) {
+			a->node[k].sibling = a->node[n].child;
+			a->node[n].child = k;
+		} else
+			a->root[(unsigned char)*pat] = k;
+	}
+	a->rulenext[rule] = a->node[n].rule;
+	a->node[n].rule = rule;
+}
+
+/* fail and output links, breadth first so every suffix is done before use */
+void
+aclink(Matcher *a)
+{
+	int *queue, head = 0, tail = 0, n, k, c;
+
+	queue = ecalloc(a->n, sizeof(int));
+	for (c = 0; c < 256; c++)
+		if ((k = a->root[c])) {
+			a->node[k].out = a->node[k].rule != -1 ? k : 0;
+			queue[tail++] = k;
+		}
+	while (head < tail) {
+		n = queue[head++];
+		for (k = a->node[n].child; k; k = a->node[k].sibling) {
+			a->node[k].fail = acstep(a, a->node[n].fail, a->node[k].ch);
+			a->node[k].out = a->node[k].rule != -1 ? k : a->node[a->node[k].fail].out;
+			queue[tail++] = k;
+		}
+	}
+	free(queue);
+}
+
+void
+acmatch(const Matcher *a, const char *s, unsigned long *bits)
+{
+	int n = 0, o, r;
+
+	memcpy(bits, a->any, sizeof(a->any));
+	if (!a->used)
+		return;
+	for (; *s; s++) {
+		n = acstep(a, n, (unsigned char)*s);
+		for (o = a->node[n].out; o; o = a->node[a->node[o].fail].out)
+			for (r = a->node[o].rule; r != -1; r = a->rulenext[r])
+				bits[r / RULEBITS] |= 1UL << (r % RULEBITS);
+	}
+}
+
+void
+compilerules(void)
+{
+	Matcher *a[] = { &classmatch, &instancematch, &titlematch };
+	unsigned int i, j;
+
+	for (j = 0; j < LENGTH(a); j++) {
+		/* node 0 is the root */
+		a[j]->size = 64;
+		a[j]->n = 1;
+		a[j]->node = ecalloc(a[j]->size, sizeof(ACNode));
+		a[j]->node[0].rule = -1;
+	}
+	for (i = 0; i < LENGTH(rules); i++) {
+		acadd(&classmatch, rules[i].class, i);
+		acadd(&instancematch, rules[i].instance, i);
+		acadd(&titlematch, rules[i].title, i);
+	}
+	for (j = 0; j < LENGTH(a); j++)
+		aclink(a[j]);
+}
+
+void
+freerules(void)
+{
+	free(classmatch.node);
+	free(instancematch.node);
+	free(titlematch.node);
+}
+
+/* bits of the rules matching a window; class and instance are memoized since
+ * titles change but most windows of a class share the same answer */
+void
+matchrules(const char *class, const char *instance, const char *title, unsigned long *bits)
+{
+	unsigned long tbits[RULEWORDS];
+	unsigned int h = 2166136261u, i;
+	const char *s;
+	RuleMemo *memo;
+
+	for (s = class; *s; s++)
+		h = (h ^ (unsigned char)*s) * 16777619u;
+	for (h ^= 0xff, s = instance; *s; s++)
+		h = (h ^ (unsigned char)*s) * 16777619u;
+	memo = &rulememo[h & (RULEMEMOSIZE - 1)];
+	if (!memo->valid || strcmp(memo->class, class) || strcmp(memo->instance, instance)) {
+		acmatch(&classmatch, class, memo->bits);
+		acmatch(&instancematch, instance, tbits);
+		for (i = 0; i < RULEWORDS; i++)
+			memo->bits[i] &= tbits[i];
+		snprintf(memo->class, sizeof memo->class, "%s", class);
+		snprintf(memo->instance, sizeof memo->instance, "%s", instance);
+		memo->valid = 1;
+	}
+	memcpy(bits, memo->bits, sizeof(memo->bits));
+	if (titlematch.used) {
+		acmatch(&titlematch, title, tbits);
+		for (i = 0; i < RULEWORDS; i++)
+			bits[i] &= tbits[i];
+	}
+}
+
 int
 applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 {
@@ -542,18 +957,15 @@ applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 	return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
 }
 
+/* arrange, restack and drawbar only mark the monitor, commit() does the work
+ * once for everything the handlers of an event batch asked for */
 void
 arrange(Monitor *m)
 {
 	if (m)
-		showhide(m->stack);
+		m->dirty |= DirtyArrange | DirtyRestack | DirtyBar;
 	else for (m = mons; m; m = m->next)
-		showhide(m->stack);
-	if (m) {
-		arrangemon(m);
-		restack(m);
-	} else for (m = mons; m; m = m->next)
-		arrangemon(m);
+		m->dirty |= DirtyArrange | DirtyBar;
 }
 
 void
@@ -567,18 +979,23 @@ swallow(Client *p, Client *c)
 
 	detach(c);
 	detachstack(c);
+	detachhash(c);
 
 	setclientstate(c, WithdrawnState);
 	XUnmapWindow(dpy, p->win);
+	dequeuegeom(c);
 
 	p->swallowing = c;
 	c->mon = p->mon;
 
+	detachhash(p);
 	Window w = p->win;
 	p->win = c->win;
 	c->win = w;
+	attachhash(p);
+	attachswallow(p);
 	updatetitle(p);
-	XMoveResizeWindow(dpy, p->win, p->x, p->y, p->w, p->h);
+	moveresizewin(p, p->x, p->y, p->w, p->h);
 	arrange(p->mon);
 	configure(p);
 	updateclientlist();
@@ -587,8 +1004,12 @@ swallow(Client *p, Client *c)
 void
 unswallow(Client *c)
 {
+	detachhash(c);
+	detachswallow(c);
 	c->win = c->swallowing->win;
+	attachhash(c);
 
+	dequeuegeom(c->swallowing);
 	free(c->swallowing);
 	c->swallowing = NULL;
 
@@ -597,7 +1018,7 @@ unswallow(Client *c)
 	updatetitle(c);
 	arrange(c->mon);
 	XMapWindow(dpy, c->win);
-	XMoveResizeWindow(dpy, c->win, c->x, c->y, c->w, c->h);
+	moveresizewin(c, c->x, c->y, c->w, c->h);
 	setclientstate(c, NormalState);
 	focus(NULL);
 	arrange(c->mon);
@@ -641,13 +1062,23 @@ void checkanimate(Client *c, int x, int y, int w, int h, int frames, int resetpo
     }
 }
 
-
 // move client to position within a set amount of frames
-void animateclient(Client *c, int x, int y, int w, int h, int frames, int resetpos)
+void
+animateclient(Client *c, int x, int y, int w, int h, int frames, int resetpos)
+{
+	animate(c, x, y, w, h, frames, resetpos, NULL);
+}
+
+/* Queue a tween towards x, y. It is ticked from the frame clock of c's monitor
+ * in run(), so the event loop keeps dispatching while the client moves. done
+ * runs once the tween has ended; for resetpos tweens it runs before the client
+ * is put back, so it can hide the window first. */
+void
+animate(Client *c, int x, int y, int w, int h, int frames, int resetpos, void (*done)(Client *))
 {
-	int time;
-	int oldx, oldy;
+	Anim *a = &c->anim;
 	int width, height;
+
 	width = w ? w : c->w;
 	height = h ? h : c->h;
 
@@ -658,32 +1089,244 @@ void animateclient(Client *c, int x, int y, int w, int h, int frames, int resetp
 	if (height > selmon->wh - (2 * c->bw))
 		height = selmon->wh - (2 * c->bw);
 
-	time = 1;
-	oldx = c->x;
-	oldy = c->y;
+	/* retargeting an in-flight tween keeps its completion */
+	if (!a->frames || done)
+		a->done = done;
+	a->resetpos = resetpos;
+	a->ghost = 0;
+	a->fx = resetpos ? c->x : x;
+	a->fy = resetpos ? c->y : y;
+	a->fw = width;
+	a->fh = height;
+	a->start = nowns();
+	a->frames = MAX(frames, 1);
+
+	if (!animated || !(abs(c->x - x) > 10 || abs(c->y - y) > 10 || abs(w - c->w) > 10 || abs(h - c->h) > 10)) {
+		animfinish(c);
+		return;
+	}
 
-	if (animated && (abs(oldx - x) > 10 || abs(oldy - y) > 10 || abs(w - c->w) > 10 || abs(h - c->h) > 10)) {
-		if (x == c->x && y == c->y && c->w < selmon->mw - 50) {
-			animateclient(c, c->x + (width - c->w), c->y + (height - c->h), 0, 0, frames, 0);
-		} else {
-			while (time < frames)
-			{
-				resize(c,
-					oldx + easeOutQuint(((double)time/frames)) * (x - oldx),
-					oldy + easeOutQuint(((double)time/frames)) * (y - oldy), width, height, 1);
-				time++;
-				usleep(15000);
-			}
+	a->ox = c->x;
+	a->oy = c->y;
+	if (x == c->x && y == c->y && c->w < selmon->mw - 50) {
+		a->tx = c->x + (width - c->w);
+		a->ty = c->y + (height - c->h);
+		a->tw = c->w;
+		a->th = c->h;
+	} else {
+		a->tx = x;
+		a->ty = y;
+		a->tw = width;
+		a->th = height;
+	}
+	/* the size is applied up front, only the position eases */
+	a->ow = a->tw;
+	a->oh = a->th;
+
+	animstep(c, a->start);
+	if (animarm(c->mon) < 0)
+		animfinish(c);
+}
+
+/* start the frame clock of m at its refresh rate, creating it on first use */
+int
+animarm(Monitor *m)
+{
+	struct itimerspec its = { { 0, m->framens }, { 0, m->framens } };
+	struct epoll_event ev = { .events = EPOLLIN };
+
+	if (m->clockarmed)
+		return 0;
+	if (m->clockfd == -1) {
+		m->clockfd = ev.data.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (m->clockfd != -1 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, m->clockfd, &ev)) {
+			close(m->clockfd);
+			m->clockfd = -1;
 		}
 	}
+	if (m->clockfd == -1 || timerfd_settime(m->clockfd, 0, &its, NULL)) {
+		fputs("Failed to start the frame clock, animations disabled\n", stderr);
+		animated = 0;
+		return -1;
+	}
+	m->clockarmed = 1;
+	return 0;
+}
 
-	if (resetpos)
-		resize(c, oldx, oldy, width, height, 0);
-	else
-		resize(c, x, y, width, height, 1);
+/* resize() from a layout during arrange(): ease c from its current geometry
+ * or, when the monitor slides to another tag, in from beside the monitor */
+void
+animlayout(Client *c, int x, int y, int w, int h)
+{
+	Anim *a = &c->anim;
+	Monitor *m = c->mon;
 
+	if (!applysizehints(c, &x, &y, &w, &h, 0) && !m->slide)
+		return;
+	a->ox = m->slide ? x + m->slide * m->mw : c->x;
+	a->oy = m->slide ? y : c->y;
+	a->ow = m->slide ? w : c->w;
+	a->oh = m->slide ? h : c->h;
+	a->tx = a->fx = x;
+	a->ty = a->fy = y;
+	a->tw = a->fw = w;
+	a->th = a->fh = h;
+	a->start = nowns();
+	a->frames = TRANSITIONFRAMES;
+	a->resetpos = 0;
+	a->ghost = 0;
+	a->done = NULL;
+	animstep(c, a->start);
+	if (animarm(m) < 0)
+		animfinish(c);
+}
+
+/* push the tiled clients of m's current view out of the monitor towards -dir
+ * and make the following arrange() bring the new view in from dir */
+void
+animslideout(Monitor *m, int dir)
+{
+	Anim *a;
+	Client *c;
+	long long now = nowns();
+
+	if (!animated)
+		return;
+	for (c = nexttiled(m->clients); c; c = nexttiled(c->next)) {
+		a = &c->anim;
+		if (a->frames && !a->ghost)
+			animfinish(c);
+		a->ox = a->fx = c->x;
+		a->oy = a->ty = a->fy = c->y;
+		a->tx = c->x - dir * m->mw;
+		a->ow = a->tw = a->fw = c->w;
+		a->oh = a->th = a->fh = c->h;
+		a->start = now;
+		a->frames = TRANSITIONFRAMES;
+		a->resetpos = 0;
+		a->ghost = 1;
+		a->done = NULL;
+	}
+	m->slide = dir;
+	if (animarm(m) < 0)
+		for (c = m->clients; c; c = c->next)
+			if (c->anim.frames)
+				animfinish(c);
 }
 
+/* end the tween of c now: commit its final geometry and run its completion */
+void
+animfinish(Client *c)
+{
+	Anim a = c->anim;
+
+	c->anim.frames = 0;
+	c->anim.done = NULL;
+	if (a.ghost) {
+		if (!ISVISIBLE(c))
+			movewin(c, WIDTH(c) * -2, c->y);
+		return;
+	}
+	if (a.resetpos && a.done)
+		a.done(c);
+	if (ISVISIBLE(c))
+		resize(c, a.fx, a.fy, a.fw, a.fh, !a.resetpos);
+	else {
+		c->x = a.fx;
+		c->y = a.fy;
+		c->w = a.fw;
+		c->h = a.fh;
+	}
+	if (!a.resetpos && a.done)
+		a.done(c);
+}
+
+/* a layout moved c while it was animating: ease from where it is now */
+void
+animretarget(Client *c, int x, int y, int w, int h)
+{
+	Anim *a = &c->anim;
+
+	if (a->fx == x && a->fy == y && a->fw == w && a->fh == h)
+		return;
+	a->ox = c->x;
+	a->oy = c->y;
+	a->ow = c->w;
+	a->oh = c->h;
+	a->tx = a->fx = x;
+	a->ty = a->fy = y;
+	a->tw = a->fw = w;
+	a->th = a->fh = h;
+	a->resetpos = 0;
+	a->start = nowns();
+	/* c may have been sent to a monitor whose clock is idle */
+	if (animarm(c->mon) < 0)
+		a->start = 0;
+}
+
+/* put c where its tween is at time now */
+void
+animstep(Client *c, long long now)
+{
+	Anim *a = &c->anim;
+	long long t, len = (long long)a->frames * FRAMENS;
+	double e;
+	int x, y, w, h;
+
+	/* hidden clients are not worth animating, land them right away */
+	if (!ISVISIBLE(c) && !a->ghost)
+		a->start = 0;
+	t = MAX(now - a->start, 0);
+	if (t >= len)
+		return;
+	e = easetab[t * EASESTEPS / len];
+	x = a->ox + e * (a->tx - a->ox);
+	y = a->oy + e * (a->ty - a->oy);
+	w = a->ow + e * (a->tw - a->ow);
+	h = a->oh + e * (a->th - a->oh);
+	if (a->ghost)
+		movewin(c, x, y);
+	else if (applysizehints(c, &x, &y, &w, &h, 1))
+		resizeclient(c, x, y, w, h);
+}
+
+Client *
+animdue(Monitor *m, long long now)
+{
+	Client *c;
+
+	for (c = m->clients; c; c = c->next)
+		if (c->anim.frames && now - c->anim.start >= (long long)c->anim.frames * FRAMENS)
+			return c;
+	return NULL;
+}
+
+/* move every tween on m to where it is at this frame; tweens that ran out are
+ * finished afterwards, since their completions may manage, unmanage or
+ * rearrange clients */
+void
+animtick(Monitor *m)
+{
+	struct itimerspec its = { { 0, 0 }, { 0, 0 } };
+	long long now = nowns();
+	Client *c;
+	int active;
+
+	for (c = m->clients; c; c = c->next)
+		if (c->anim.frames)
+			animstep(c, now);
+	while ((c = animdue(m, now)))
+		animfinish(c);
+	flushgeom();
+	XFlush(dpy);
+
+	for (active = 0, c = m->clients; c; c = c->next)
+		active |= c->anim.frames != 0;
+	if (!active && m->clockarmed) {
+		timerfd_settime(m->clockfd, 0, &its, NULL);
+		m->clockarmed = 0;
+	}
+}
 
 // disable/enable animations
 void
@@ -712,6 +1355,24 @@ attachstack(Client *c)
 	c->mon->stack = c;
 }
 
+void
+attachhash(Client *c)
+{
+	Client **h = &wintab[WINHASH(c->win)];
+
+	c->hnext = *h;
+	*h = c;
+}
+
+void
+attachswallow(Client *p)
+{
+	Client **h = &swaltab[WINHASH(p->swallowing->win)];
+
+	p->swnext = *h;
+	*h = p;
+}
+
 static void
 bstack(Monitor *m) {
 	int w, h, mh, mx, tx, ty, tw;
@@ -784,7 +1445,9 @@ bstackhoriz(Monitor *m) {
 void
 buttonpress(XEvent *e)
 {
-	unsigned int i, x, click;
+	unsigned int i, click;
+	int lo, hi, mid;
+	char button[4];
 	Arg arg = {0};
 	Client *c;
 	Monitor *m;
@@ -798,19 +1461,29 @@ buttonpress(XEvent *e)
 		focus(NULL);
 	}
 	if (ev->window == selmon->barwin) {
-		i = x = 0;
-		do
-			x += TEXTW(tags[i]);
-		while (ev->x >= x && ++i < LENGTH(tags));
-		if (i < LENGTH(tags)) {
-			click = ClkTagBar;
-			arg.ui = 1 << i;
-		} else if (ev->x < x + blw)
-			click = ClkLtSymbol;
-		else if (ev->x > selmon->ww - TEXTW(stext))
-			click = ClkStatusText;
-		else
-			click = ClkWinTitle;
+		/* the last region starting left of the click */
+		click = ClkWinTitle;
+		for (lo = 0, hi = selmon->nregions; lo < hi;) {
+			mid = (lo + hi) / 2;
+			if (selmon->regions[mid].x <= ev->x)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo) {
+			click = selmon->regions[lo - 1].click;
+			arg.ui = selmon->regions[lo - 1].arg;
+		}
+		/* a command bound to the status learns which segment it was, unless
+		 * a datagram since the last draw removed it */
+		if (click == ClkStatusText && arg.ui) {
+			for (i = 0; i < nsegs && segs[i].id != arg.ui; i++);
+			if (i < nsegs) {
+				setenv("DWM_SEGMENT", segs[i].name, 1);
+				snprintf(button, sizeof button, "%u", ev->button);
+				setenv("DWM_BUTTON", button, 1);
+			}
+		}
 	} else if ((c = wintoclient(ev->window))) {
 		focus(c);
 		restack(selmon);
@@ -821,6 +1494,8 @@ buttonpress(XEvent *e)
 		if (click == buttons[i].click && buttons[i].func && buttons[i].button == ev->button
 		&& CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state))
 			buttons[i].func(click == ClkTagBar && buttons[i].arg.i == 0 ? &arg : &buttons[i].arg);
+	unsetenv("DWM_SEGMENT");
+	unsetenv("DWM_BUTTON");
 }
 
 void
@@ -859,8 +1534,32 @@ cleanup(void)
 	XSync(dpy, False);
 	XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
 	XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
+	for (i = 0; i < PROCHASHSIZE; i++)
+		while (proctab[i])
+			close(procevict(proctab[i]));
+	procbury();
+	freerules();
+	for (i = 0; i < nstatusschemes; i++)
+		free(statusschemes[i].scheme);
+	if (status_fd != -1) {
+		close(status_fd);
+		unlink(statussockpath);
+	}
+	for (i = 0; i < LENGTH(modules); i++) {
+		if (modstate[i].tfd != -1)
+			close(modstate[i].tfd);
+		if (modstate[i].fd != -1)
+			close(modstate[i].fd);
+	}
 
-	//ipc_cleanup();
+	ipc_cleanup();
+
+#ifdef _DEBUG
+	for (i = 0; i < LASTEvent; i++)
+		if (evcollapsed[i])
+			fprintf(stderr, "dwm: event %zu: %lu of %lu collapsed\n",
+				i, evcollapsed[i], evseen[i]);
+#endif /* _DEBUG */
 
 	if (close(epoll_fd) < 0) {
 			fprintf(stderr, "Failed to close epoll file descriptor\n");
@@ -882,9 +1581,133 @@ cleanupmon(Monitor *mon)
 		XUnmapWindow(dpy, mon->barwin);
 		XDestroyWindow(dpy, mon->barwin);
 	}
+	drw_buf_free(drw, mon->barbuf);
+	if (mon == statusmon)
+		statusmon = NULL;
+	if (mon->clockfd != -1)
+		close(mon->clockfd);
 	free(mon);
 }
 
+/* wait for the replies to requestprops(); a window that is gone by now
+ * leaves p->ok unset */
+void
+collectprops(PropCookies *ck, Props *p)
+{
+	xcb_get_window_attributes_reply_t *ar;
+	xcb_get_geometry_reply_t *gr;
+	xcb_get_property_reply_t *r;
+	xcb_generic_error_t *e = NULL;
+	const int32_t *v;
+	char *val;
+	int len, n;
+
+	memset(p, 0, sizeof(*p));
+	ar = xcb_get_window_attributes_reply(xcon, ck->attrs, &e);
+	free(e);
+	gr = xcb_get_geometry_reply(xcon, ck->geom, &e);
+	free(e);
+	if ((p->ok = ar && gr)) {
+		p->wa.x = gr->x;
+		p->wa.y = gr->y;
+		p->wa.width = gr->width;
+		p->wa.height = gr->height;
+		p->wa.border_width = gr->border_width;
+		p->wa.map_state = ar->map_state;
+		p->wa.override_redirect = ar->override_redirect;
+	}
+	free(ar);
+	free(gr);
+
+	r = xcb_get_property_reply(xcon, ck->netname, &e);
+	free(e);
+	n = textprop(r, p->name, sizeof p->name);
+	free(r);
+	r = xcb_get_property_reply(xcon, ck->name, &e);
+	free(e);
+	if (!n)
+		textprop(r, p->name, sizeof p->name);
+	free(r);
+
+	r = xcb_get_property_reply(xcon, ck->trans, &e);
+	free(e);
+	if ((p->hastrans = r && r->type == XA_WINDOW && r->format == 32 && r->value_len))
+		p->trans = *(uint32_t *)xcb_get_property_value(r);
+	free(r);
+
+	/* WM_CLASS holds the instance and the class, each NUL terminated */
+	r = xcb_get_property_reply(xcon, ck->class, &e);
+	free(e);
+	if (r && r->type == XA_STRING && r->format == 8) {
+		val = xcb_get_property_value(r);
+		len = xcb_get_property_value_length(r);
+		n = strnlen(val, len);
+		snprintf(p->instance, sizeof p->instance, "%.*s", n, val);
+		if (n + 1 < len)
+			snprintf(p->class, sizeof p->class, "%.*s", (int)strnlen(val + n + 1, len - n - 1), val + n + 1);
+	}
+	free(r);
+
+	r = xcb_get_property_reply(xcon, ck->state, &e);
+	free(e);
+	if (r && r->type == XA_ATOM && r->format == 32 && r->value_len)
+		p->state = *(uint32_t *)xcb_get_property_value(r);
+	free(r);
+	r = xcb_get_property_reply(xcon, ck->wtype, &e);
+	free(e);
+	if (r && r->type == XA_ATOM && r->format == 32 && r->value_len)
+		p->wtype = *(uint32_t *)xcb_get_property_value(r);
+	free(r);
+
+	/* decoded the way XGetWMNormalHints() does, pre-ICCCM hints lack
+	 * the base size and gravity */
+	r = xcb_get_property_reply(xcon, ck->normalhints, &e);
+	free(e);
+	if ((p->hassize = r && r->type == XA_WM_SIZE_HINTS && r->format == 32 && r->value_len >= 15)) {
+		v = xcb_get_property_value(r);
+		p->size.flags = v[0];
+		p->size.x = v[1];
+		p->size.y = v[2];
+		p->size.width = v[3];
+		p->size.height = v[4];
+		p->size.min_width = v[5];
+		p->size.min_height = v[6];
+		p->size.max_width = v[7];
+		p->size.max_height = v[8];
+		p->size.width_inc = v[9];
+		p->size.height_inc = v[10];
+		p->size.min_aspect.x = v[11];
+		p->size.min_aspect.y = v[12];
+		p->size.max_aspect.x = v[13];
+		p->size.max_aspect.y = v[14];
+		if (r->value_len >= 18) {
+			p->size.base_width = v[15];
+			p->size.base_height = v[16];
+			p->size.win_gravity = v[17];
+		} else
+			p->size.flags &= ~(PBaseSize | PWinGravity);
+	}
+	free(r);
+
+	r = xcb_get_property_reply(xcon, ck->hints, &e);
+	free(e);
+	if ((p->haswmh = r && r->type == XA_WM_HINTS && r->format == 32 && r->value_len >= 8)) {
+		v = xcb_get_property_value(r);
+		p->wmh.flags = v[0];
+		p->wmh.input = v[1];
+		p->wmh.initial_state = v[2];
+		p->wmh.icon_pixmap = v[3];
+		p->wmh.icon_window = v[4];
+		p->wmh.icon_x = v[5];
+		p->wmh.icon_y = v[6];
+		p->wmh.icon_mask = v[7];
+		p->wmh.window_group = r->value_len >= 9 ? v[8] : 0;
+	}
+	free(r);
+
+	p->pid = replypid(ck->pid);
+}
+
 void
 clientmessage(XEvent *e)
 {
@@ -908,6 +1731,77 @@ clientmessage(XEvent *e)
 	}
 }
 
+/* apply what the handlers left dirty: layouts first, so that all clients of
+ * all monitors move in the same frames, then focus, stacking and bars */
+void
+commit(void)
+{
+	Monitor *m;
+	Client *c;
+	int dirty;
+
+	do {
+		for (m = mons; m; m = m->next)
+			if (m->dirty & DirtyArrange)
+				showhide(m->stack);
+		/* every tiled client moved by the layout eases to its new
+		 * geometry within the same frames */
+		transition = animated;
+		for (m = mons; m; m = m->next)
+			if (m->dirty & DirtyArrange) {
+				m->dirty &= ~DirtyArrange;
+				arrangemon(m);
+				m->slide = 0;
+			}
+		transition = 0;
+		for (m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next)
+				if (c->dropin)
+					dropin(c);
+		flushgeom();
+		if (focusdirty) {
+			focusdirty = 0;
+			commitfocus();
+		}
+		for (m = mons; m; m = m->next)
+			if (m->dirty & DirtyRestack) {
+				m->dirty &= ~DirtyRestack;
+				restackmon(m);
+			}
+		for (m = mons; m; m = m->next)
+			if (m->dirty & DirtyBar) {
+				m->dirty &= ~(DirtyBar | DirtyStatus);
+				drawbarmon(m);
+			}
+		for (m = mons; m; m = m->next)
+			if (m->dirty & DirtyStatus) {
+				m->dirty &= ~DirtyStatus;
+				drawstatusmon(m);
+			}
+		for (dirty = focusdirty, m = mons; m; m = m->next)
+			dirty |= m->dirty;
+	} while (dirty);
+}
+
+/* give the server's focus and the focus borders to selmon->sel */
+void
+commitfocus(void)
+{
+	Client *c = selmon->sel;
+
+	if (xfocus && xfocus != c)
+		unfocus(xfocus, 0);
+	if (c) {
+		grabbuttons(c, 1);
+		XSetWindowBorder(dpy, c->win, scheme[SchemeSel][ColBorder].pixel);
+		setfocus(c);
+	} else {
+		XSetInputFocus(dpy, root, RevertToPointerRoot, CurrentTime);
+		XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
+	}
+	xfocus = c;
+}
+
 void
 configure(Client *c)
 {
@@ -927,6 +1821,52 @@ configure(Client *c)
 	XSendEvent(dpy, c->win, False, StructureNotifyMask, (XEvent *)&ce);
 }
 
+void
+dequeuegeom(Client *c)
+{
+	Client **tc;
+
+	if (!c->queued)
+		return;
+	for (tc = &geomq; *tc && *tc != c; tc = &(*tc)->qnext);
+	if (*tc)
+		*tc = c->qnext;
+	c->queued = 0;
+}
+
+/* send the geometry of every queued client, leaving out what the server
+ * already has; no round trip, the requests go out with the next flush */
+void
+flushgeom(void)
+{
+	Client *c;
+	XWindowChanges wc;
+	unsigned int mask;
+
+	while ((c = geomq)) {
+		geomq = c->qnext;
+		c->queued = 0;
+		/* hidden clients keep their size but stay off screen */
+		wc.x = ISVISIBLE(c) ? c->x : WIDTH(c) * -2;
+		wc.y = c->y;
+		wc.width = c->w;
+		wc.height = c->h;
+		wc.border_width = c->bw;
+		mask = (wc.x != c->cx ? CWX : 0) | (wc.y != c->cy ? CWY : 0)
+			| (wc.width != c->cw ? CWWidth : 0) | (wc.height != c->ch ? CWHeight : 0)
+			| (wc.border_width != c->cbw ? CWBorderWidth : 0);
+		if (!mask)
+			continue;
+		XConfigureWindow(dpy, c->win, mask, &wc);
+		c->cx = wc.x;
+		c->cy = wc.y;
+		c->cw = wc.width;
+		c->ch = wc.height;
+		c->cbw = wc.border_width;
+		configure(c);
+	}
+}
+
 void
 configurenotify(XEvent *e)
 {
@@ -941,7 +1881,6 @@ configurenotify(XEvent *e)
 		sw = ev->width;
 		sh = ev->height;
 		if (updategeom() || dirty) {
-			drw_resize(drw, sw, bh);
 			updatebars();
 			for (m = mons; m; m = m->next) {
         for (c = m->clients; c; c = c->next)
@@ -993,7 +1932,7 @@ configurerequest(XEvent *e)
 			if ((ev->value_mask & (CWX|CWY)) && !(ev->value_mask & (CWWidth|CWHeight)))
 				configure(c);
 			if (ISVISIBLE(c))
-				XMoveResizeWindow(dpy, c->win, c->x, c->y, c->w, c->h);
+				moveresizewin(c, c->x, c->y, c->w, c->h);
 		} else
 			configure(c);
 	} else {
@@ -1005,6 +1944,8 @@ configurerequest(XEvent *e)
 		wc.sibling = ev->above;
 		wc.stack_mode = ev->detail;
 		XConfigureWindow(dpy, ev->window, ev->value_mask, &wc);
+		/* the prefetched geometry is stale now */
+		prefetchrefresh(ev->window, None);
 	}
 	XSync(dpy, False);
 }
@@ -1028,6 +1969,8 @@ createmon(void)
 	m->gappov = gappov;
   m->topbar = topbar;
   m->bh = bh;
+	m->framens = 1000000000 / xfps;
+	m->clockfd = -1;
 //	m->lt[0] = &layouts[0];
 //	m->lt[1] = &layouts[1 % LENGTH(layouts)];
 //	strncpy(m->ltsymbol, layouts[0].symbol, sizeof m->ltsymbol);
@@ -1096,6 +2039,20 @@ for (i = 0; i <= LENGTH(tags); i++) {
 	return m;
 }
 
+/* start fetching what manage() will want while the client is still busy
+ * setting up the window, so the MapRequest finds it already local */
+void
+createnotify(XEvent *e)
+{
+	XCreateWindowEvent *ev = &e->xcreatewindow;
+
+	if (ev->parent != root || ev->override_redirect)
+		return;
+	/* property changes until the map invalidate the prefetch */
+	XSelectInput(dpy, ev->window, PropertyChangeMask);
+	prefetch(ev->window);
+}
+
 void
 cyclelayout(const Arg *arg) {
 	Layout *l;
@@ -1123,6 +2080,7 @@ destroynotify(XEvent *e)
 	Monitor *m;
 	XDestroyWindowEvent *ev = &e->xdestroywindow;
 
+	prefetchdrop(ev->window);
 	if ((c = wintoclient(ev->window)))
 		unmanage(c, 1);
 	else if ((m = wintomon(ev->window)) && m->barwin == ev->window)
@@ -1156,6 +2114,26 @@ detachstack(Client *c)
 	}
 }
 
+void
+detachhash(Client *c)
+{
+	Client **tc;
+
+	for (tc = &wintab[WINHASH(c->win)]; *tc && *tc != c; tc = &(*tc)->hnext);
+	if (*tc)
+		*tc = c->hnext;
+}
+
+void
+detachswallow(Client *p)
+{
+	Client **tc;
+
+	for (tc = &swaltab[WINHASH(p->swallowing->win)]; *tc && *tc != p; tc = &(*tc)->swnext);
+	if (*tc)
+		*tc = p->swnext;
+}
+
 Monitor *
 dirtomon(int dir)
 {
@@ -1172,23 +2150,60 @@ dirtomon(int dir)
 
 void
 drawbar(Monitor *m)
+{
+	m->dirty |= DirtyBar;
+}
+
+void
+barregion(Monitor *m, int x, unsigned int click, unsigned int arg)
+{
+	if (m->nregions < BARREGIONS) {
+		m->regions[m->nregions].x = x;
+		m->regions[m->nregions].click = click;
+		m->regions[m->nregions].arg = arg;
+		m->nregions++;
+	}
+}
+
+void
+drawbarmon(Monitor *m)
 {
 	if (usealtbar)
 		return;
 
 
 
-	int x, w, sw = 0;
+	int x, w, sw, sx;
 	int boxs = drw->fonts->h / 9;
 	int boxw = drw->fonts->h / 6 + 2;
 	unsigned int i, occ = 0, urg = 0;
 	Client *c;
 
+	if (!m->barbuf || m->barbuf->w != m->ww || m->barbuf->h != bh) {
+		drw_buf_free(drw, m->barbuf);
+		m->barbuf = drw_buf_create(drw, m->ww, bh);
+	}
+	drw_setbuf(drw, m->barbuf);
+
+	/* the status is only drawn on the selected monitor, but clicking where
+	 * it would be selects the monitor first, so every bar lays it out */
+	sw = TEXTW(stext) - lrpad + 2; /* 2px right padding */
+	for (i = 0; i < nsegs; i++)
+		sw += segs[i].w = TEXTW(segs[i].text);
+
 	/* draw status first so it can be overdrawn by tags later */
-	if (m == selmon) { /* status is only drawn on selected monitor */
+	if (m == selmon) {
+		for (x = m->ww - sw, i = 0; i < nsegs; x += segs[i++].w) {
+			segs[i].x = x;
+			segs[i].dirty = 0;
+			drw_setscheme(drw, segs[i].scheme);
+			drw_text(drw, x, 0, segs[i].w, bh, lrpad / 2, segs[i].text, 0);
+		}
 		drw_setscheme(drw, scheme[SchemeNorm]);
-		sw = TEXTW(stext) - lrpad + 2; /* 2px right padding */
-		drw_text(drw, m->ww - sw, 0, sw, bh, 0, stext, 0);
+		drw_text(drw, x, 0, m->ww - x, bh, 0, stext, 0);
+		statusmon = m;
+	} else if (m == statusmon) {
+		statusmon = NULL;
 	}
 
 	for (c = m->clients; c; c = c->next) {
@@ -1196,11 +2211,13 @@ drawbar(Monitor *m)
 		if (c->isurgent)
 			urg |= c->tags;
 	}
+	m->nregions = 0;
 	x = 0;
 	for (i = 0; i < LENGTH(tags); i++) {
 		w = TEXTW(tags[i]);
+		barregion(m, x, ClkTagBar, 1 << i);
 		drw_setscheme(drw, scheme[m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm]);
-		drw_text(drw, x, 0, w, bh, lrpad / 2, tags[i], urg & 1 << i);
+		drw_label(drw, x, 0, w, bh, lrpad / 2, tags[i], urg & 1 << i);
 		if (occ & 1 << i)
 			drw_rect(drw, x + boxs, boxs, boxw, boxw,
 				m == selmon && selmon->sel && selmon->sel->tags & 1 << i,
@@ -1208,10 +2225,21 @@ drawbar(Monitor *m)
 		x += w;
 	}
 	w = blw = TEXTW(m->ltsymbol);
+	barregion(m, x, ClkLtSymbol, 0);
 	drw_setscheme(drw, scheme[SchemeNorm]);
-	x = drw_text(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
-
-	if ((w = m->ww - sw - x) > bh) {
+	x = drw_label(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
+	if (x < m->ww - sw)
+		barregion(m, x, ClkWinTitle, 0);
+	/* a region per segment, then the root window name; tags overdraw a
+	 * status too wide for the rest */
+	for (sx = m->ww - sw, i = 0; i < nsegs; sx += segs[i++].w)
+		if (sx + segs[i].w > x)
+			barregion(m, MAX(x, sx), ClkStatusText, segs[i].id);
+	barregion(m, MAX(x, sx), ClkStatusText, 0);
+	if (m == selmon)
+		statusmin = x;
+
+	if ((w = m->ww - (m == selmon ? sw : 0) - x) > bh) {
 		if (m->sel) {
 			drw_setscheme(drw, scheme[m == selmon ? SchemeSel : SchemeNorm]);
 			drw_text(drw, x, 0, w, bh, lrpad / 2, m->sel->name, 0);
@@ -1234,6 +2262,47 @@ drawbars(void)
 		drawbar(m);
 }
 
+/* redraw only the segments whose text changed but not their width */
+void
+drawstatusmon(Monitor *m)
+{
+	unsigned int i;
+
+	if (m != statusmon || !m->barbuf || m->barbuf->w != m->ww) {
+		drawbarmon(m);
+		return;
+	}
+	drw_setbuf(drw, m->barbuf);
+	for (i = 0; i < nsegs; i++) {
+		if (!segs[i].dirty)
+			continue;
+		segs[i].dirty = 0;
+		drw_setscheme(drw, segs[i].scheme);
+		drw_text(drw, segs[i].x, 0, segs[i].w, bh, lrpad / 2, segs[i].text, 0);
+		drw_map(drw, m->barwin, segs[i].x, 0, segs[i].w, bh);
+	}
+}
+
+/* let a freshly managed client fall into the place its layout gave it */
+void
+dropin(Client *c)
+{
+	c->dropin = 0;
+	/* it drops in below, it does not ease in from the layout */
+	if (c->anim.frames)
+		animfinish(c);
+	if (!animated || c->isfullscreen)
+		return;
+	resizeclient(c, c->x, c->y - 70, c->w, c->h);
+	animateclient(c, c->x, c->y + 70, 0, 0, 7, 0);
+	if (NULL == c->mon->lt[c->mon->sellt]->arrange) {
+		XRaiseWindow(dpy, c->win);
+	} else {
+		if (c->w > c->mon->mw - 30 || c->h > c->mon->mh - 30)
+			arrange(c->mon);
+	}
+}
+
 void
 enternotify(XEvent *e)
 {
@@ -1259,17 +2328,22 @@ expose(XEvent *e)
 	Monitor *m;
 	XExposeEvent *ev = &e->xexpose;
 
-	if (ev->count == 0 && (m = wintomon(ev->window)))
+	if (!(m = wintomon(ev->window)) || ev->window != m->barwin)
+		return;
+	/* a bar drawn at its current size only needs copying back */
+	if (m->barbuf && m->barbuf->w == m->ww && m->barbuf->h == bh && !(m->dirty & DirtyBar)) {
+		drw_setbuf(drw, m->barbuf);
+		drw_map(drw, m->barwin, ev->x, ev->y, ev->width, ev->height);
+	} else if (ev->count == 0)
 		drawbar(m);
 }
 
+/* only the model changes here, the server hears of it in commitfocus() */
 void
 focus(Client *c)
 {
 	if (!c || !ISVISIBLE(c))
 		for (c = selmon->stack; c && !ISVISIBLE(c); c = c->snext);
-	if (selmon->sel && selmon->sel != c)
-		unfocus(selmon->sel, 0);
 	if (c) {
 		if (c->mon != selmon)
 			selmon = c->mon;
@@ -1277,14 +2351,9 @@ focus(Client *c)
 			seturgent(c, 0);
 		detachstack(c);
 		attachstack(c);
-		grabbuttons(c, 1);
-		XSetWindowBorder(dpy, c->win, scheme[SchemeSel][ColBorder].pixel);
-		setfocus(c);
-	} else {
-		XSetInputFocus(dpy, root, RevertToPointerRoot, CurrentTime);
-		XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
 	}
 	selmon->sel = c;
+	focusdirty = 1;
 	drawbars();
 }
 
@@ -1355,6 +2424,15 @@ getatomprop(Client *c, Atom prop)
 	return atom;
 }
 
+void
+getprops(Window w, Props *p)
+{
+	PropCookies ck;
+
+	requestprops(w, &ck);
+	collectprops(&ck, p);
+}
+
 int
 getrootptr(int *x, int *y)
 {
@@ -1385,26 +2463,48 @@ getstate(Window w)
 
 int
 gettextprop(Window w, Atom atom, char *text, unsigned int size)
+{
+	xcb_get_property_reply_t *r;
+	xcb_generic_error_t *e = NULL;
+	int ret;
+
+	r = xcb_get_property_reply(xcon, xcb_get_property(xcon, 0, w, atom,
+		XCB_GET_PROPERTY_TYPE_ANY, 0, TEXTPROPLEN), &e);
+	free(e);
+	ret = textprop(r, text, size);
+	free(r);
+	return ret;
+}
+
+/* decode a text property reply into text, as XGetTextProperty() and
+ * XmbTextPropertyToTextList() would */
+int
+textprop(xcb_get_property_reply_t *r, char *text, unsigned int size)
 {
 	char **list = NULL;
-	int n;
+	int n, len;
 	XTextProperty name;
 
 	if (!text || size == 0)
 		return 0;
 	text[0] = '\0';
-	if (!XGetTextProperty(dpy, w, &name, atom) || !name.nitems)
+	if (!r || !r->type || !(len = xcb_get_property_value_length(r)))
 		return 0;
-	if (name.encoding == XA_STRING)
-		strncpy(text, (char *)name.value, size - 1);
+	if (r->type == XA_STRING)
+		snprintf(text, size, "%.*s", len, (char *)xcb_get_property_value(r));
 	else {
+		name.value = ecalloc(len + 1, 1);
+		memcpy(name.value, xcb_get_property_value(r), len);
+		name.encoding = r->type;
+		name.format = r->format;
+		name.nitems = r->value_len;
 		if (XmbTextPropertyToTextList(dpy, &name, &list, &n) >= Success && n > 0 && *list) {
 			strncpy(text, *list, size - 1);
 			XFreeStringList(list);
 		}
+		free(name.value);
 	}
 	text[size - 1] = '\0';
-	XFree(name.value);
 	return 1;
 }
 
@@ -1475,18 +2575,31 @@ prevlayout(const Arg *arg) {
         setlayout(&((Arg) { .v = &layouts[LENGTH(layouts) - 2] }));
 }
 
+Monitor *
+clocktomon(int fd)
+{
+	Monitor *m;
+
+	for (m = mons; m && m->clockfd != fd; m = m->next);
+	return m;
+}
+
+void
+handleclock(Monitor *m)
+{
+	uint64_t expirations;
+
+	/* tweens are timed, missed frames need no catching up */
+	if (read(m->clockfd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return;
+	animtick(m);
+}
+
 int
 handlexevent(struct epoll_event *ev)
 {
 	if (ev->events & EPOLLIN) {
-		XEvent ev;
-		while (running && XPending(dpy)) {
-			XNextEvent(dpy, &ev);
-			if (handler[ev.type]) {
-				handler[ev.type](&ev); /* call handler */
-				//ipc_send_events(mons, &lastselmon, selmon);
-			}
-		}
+		handlexqueue();
 	} else if (ev-> events & EPOLLHUP) {
 		return -1;
 	}
@@ -1494,6 +2607,141 @@ handlexevent(struct epoll_event *ev)
 	return 0;
 }
 
+void
+handlexqueue(void)
+{
+	while (running && XPending(dpy)) {
+		/* a button or key press may start a loop that reads the
+		 * following events itself, so it closes the batch */
+		for (evbatchn = 0; evbatchn < EVBATCH && XPending(dpy); ) {
+			XNextEvent(dpy, &evbatch[evbatchn]);
+			if (evbatch[evbatchn++].type == ButtonPress
+			|| evbatch[evbatchn - 1].type == KeyPress)
+				break;
+		}
+		coalesce();
+		for (evbatchi = 0; running && evbatchi < evbatchn; evbatchi++)
+			if (evbatch[evbatchi].type)
+				dispatch(&evbatch[evbatchi]);
+		evbatchn = 0;
+	}
+	flushgeom();
+}
+
+void
+dispatch(XEvent *ev)
+{
+#ifdef XRANDR
+	if (randr && ev->type == rrevbase + RRScreenChangeNotify) {
+		XRRUpdateConfiguration(ev);
+		updaterefresh();
+		return;
+	}
+#endif /* XRANDR */
+	if (drw_shmevent(drw, ev))
+		return;
+	if (ev->type < LASTEvent && handler[ev->type]) {
+		handler[ev->type](ev); /* call handler */
+	}
+}
+
+/* the window an event is about, rather than the one it was reported on */
+Window
+evwindow(XEvent *ev)
+{
+	switch (ev->type) {
+	case ConfigureRequest: return ev->xconfigurerequest.window;
+	case MapRequest:       return ev->xmaprequest.window;
+	case ConfigureNotify:  return ev->xconfigure.window;
+	case DestroyNotify:    return ev->xdestroywindow.window;
+	case UnmapNotify:      return ev->xunmap.window;
+	case MapNotify:        return ev->xmap.window;
+	}
+	return ev->xany.window;
+}
+
+/* whether b supersedes a, so only b needs handling */
+int
+sameevent(XEvent *a, XEvent *b)
+{
+	if (a->type != b->type || evwindow(a) != evwindow(b))
+		return 0;
+	switch (a->type) {
+	case MotionNotify:
+	case ConfigureRequest:
+		return 1;
+	case PropertyNotify:
+		/* both names end up in updatetitle() */
+		if (a->xproperty.atom == netatom[NetWMName])
+			return b->xproperty.atom == netatom[NetWMName] || b->xproperty.atom == XA_WM_NAME;
+		if (a->xproperty.atom == XA_WM_NAME)
+			return b->xproperty.atom == netatom[NetWMName] || b->xproperty.atom == XA_WM_NAME;
+		return a->xproperty.atom == b->xproperty.atom;
+	}
+	return 0;
+}
+
+/* drop every batched event a later one of the same window supersedes; any
+ * other event for that window in between keeps both */
+void
+coalesce(void)
+{
+	XConfigureRequestEvent *o, *n;
+	int i, j;
+
+	for (i = 0; i < evbatchn; i++) {
+		evseen[evbatch[i].type < LASTEvent ? evbatch[i].type : 0]++;
+		if (evbatch[i].type != MotionNotify && evbatch[i].type != ConfigureRequest
+		&& evbatch[i].type != PropertyNotify)
+			continue;
+		for (j = i + 1; j < evbatchn; j++) {
+			if (!sameevent(&evbatch[i], &evbatch[j])) {
+				if (evbatch[j].type && evwindow(&evbatch[j]) == evwindow(&evbatch[i]))
+					break;
+				continue;
+			}
+			if (evbatch[i].type == ConfigureRequest) {
+				/* the later request keeps what it does not change itself */
+				o = &evbatch[i].xconfigurerequest;
+				n = &evbatch[j].xconfigurerequest;
+				if (o->value_mask & ~n->value_mask & CWX)
+					n->x = o->x;
+				if (o->value_mask & ~n->value_mask & CWY)
+					n->y = o->y;
+				if (o->value_mask & ~n->value_mask & CWWidth)
+					n->width = o->width;
+				if (o->value_mask & ~n->value_mask & CWHeight)
+					n->height = o->height;
+				if (o->value_mask & ~n->value_mask & CWBorderWidth)
+					n->border_width = o->border_width;
+				if (o->value_mask & ~n->value_mask & CWSibling)
+					n->above = o->above;
+				if (o->value_mask & ~n->value_mask & CWStackMode)
+					n->detail = o->detail;
+				n->value_mask |= o->value_mask;
+			}
+			evcollapsed[evbatch[i].type]++;
+			evbatch[i].type = 0;
+			break;
+		}
+	}
+	DEBUG("Coalesced %d events: %lu motion, %lu configure, %lu property collapsed so far\n",
+		evbatchn, evcollapsed[MotionNotify], evcollapsed[ConfigureRequest],
+		evcollapsed[PropertyNotify]);
+}
+
+/* the events of type still waiting in the batch are stale, as if they had been
+ * taken off the Xlib queue with XCheckMaskEvent() */
+void
+dropbatched(int type)
+{
+	int i;
+
+	for (i = evbatchi + 1; i < evbatchn; i++)
+		if (evbatch[i].type == type)
+			evbatch[i].type = 0;
+}
+
 void
 incnmaster(const Arg *arg)
 {
@@ -1538,14 +2786,21 @@ killclient(const Arg *arg)
 
     if (animated && selmon->sel != animclient && !selmon->sel->isfullscreen) {
         animclient = selmon->sel;
-		animateclient(selmon->sel, selmon->sel->x, selmon->mh - 20, 0, 0, 10, 0);
+		animate(selmon->sel, selmon->sel->x, selmon->mh - 20, 0, 0, 10, 0, killwin);
+		return;
     }
 
-	if (!sendevent(selmon->sel, wmatom[WMDelete])) {
+	killwin(selmon->sel);
+}
+
+void
+killwin(Client *c)
+{
+	if (!sendevent(c, wmatom[WMDelete])) {
 		XGrabServer(dpy);
 		XSetErrorHandler(xerrordummy);
 		XSetCloseDownMode(dpy, DestroyAll);
-		XKillClient(dpy, selmon->sel->win);
+		XKillClient(dpy, c->win);
 		XSync(dpy, False);
 		XSetErrorHandler(xerror);
 		XUngrabServer(dpy);
@@ -1578,30 +2833,32 @@ killunsel(const Arg *arg)
 }
 
 void
-manage(Window w, XWindowAttributes *wa)
+manage(Window w, const Props *p)
 {
 	Client *c, *t = NULL, *term = NULL;
-	Window trans = None;
+	Window trans = p->hastrans ? p->trans : None;
 	XWindowChanges wc;
+	XWMHints wmh = p->wmh;
 
 
 
 	c = ecalloc(1, sizeof(Client));
 	c->win = w;
+	c->pid = p->pid;
 	/* geometry */
-	c->x = c->oldx = wa->x;
-	c->y = c->oldy = wa->y;
-	c->w = c->oldw = wa->width;
-	c->h = c->oldh = wa->height;
-	c->oldbw = wa->border_width;
-
-	updatetitle(c);
-	if (XGetTransientForHint(dpy, w, &trans) && (t = wintoclient(trans))) {
+	c->x = c->oldx = p->wa.x;
+	c->y = c->oldy = p->wa.y;
+	c->w = c->oldw = p->wa.width;
+	c->h = c->oldh = p->wa.height;
+	c->oldbw = p->wa.border_width;
+
+	settitle(c, p->name);
+	if (p->hastrans && (t = wintoclient(trans))) {
 		c->mon = t->mon;
 		c->tags = t->tags;
 	} else {
 		c->mon = selmon;
-		applyrules(c);
+		applyrules(c, p);
 		term = termforwin(c);
 	}
 
@@ -1623,11 +2880,13 @@ manage(Window w, XWindowAttributes *wa)
 	wc.border_width = c->bw;
 
 	XConfigureWindow(dpy, w, CWBorderWidth, &wc);
+	c->cbw = c->bw;
 	XSetWindowBorder(dpy, w, scheme[SchemeNorm][ColBorder].pixel);
 	configure(c); /* propagates border_width, if size doesn't change */
-	updatewindowtype(c);
-	updatesizehints(c);
-	updatewmhints(c);
+	setwindowtype(c, p->state, p->wtype);
+	setsizehints(c, p->hassize ? &p->size : NULL);
+	if (p->haswmh)
+		setwmhints(c, &wmh);
 	XSelectInput(dpy, w, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
 	grabbuttons(c, 0);
 	c->wasfloating = 0;
@@ -1649,33 +2908,22 @@ manage(Window w, XWindowAttributes *wa)
 
 	attachaside(c);
 	attachstack(c);
+	attachhash(c);
+	if (c->isterminal && c->pid)
+		attachterm(c);
 	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
 		(unsigned char *) &(c->win), 1);
-	XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
+	moveresizewin(c, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
 	setclientstate(c, NormalState);
 	if (c->mon == selmon)
 		unfocus(selmon->sel, 0);
 	c->mon->sel = c;
+	c->dropin = 1;
 	arrange(c->mon);
 	XMapWindow(dpy, c->win);
 	if (term)
 		swallow(term, c);
 	focus(NULL);
-
-
-
-	if (animated && !c->isfullscreen) {
-        resizeclient(c, c->x, c->y - 70, c->w, c->h);
-        animateclient(c,c->x, c->y + 70, 0,0,7,0);
-        if (NULL == c->mon->lt[selmon->sellt]->arrange ) {
-            XRaiseWindow(dpy, c->win);
-        } else {
-            if (c->w > selmon->mw - 30 || c->h > selmon->mh - 30)
-                arrange(selmon);
-        }
-	}
-
-
 }
 
 void
@@ -1730,17 +2978,19 @@ mappingnotify(XEvent *e)
 void
 maprequest(XEvent *e)
 {
-	static XWindowAttributes wa;
+	static Props p;
 	XMapRequestEvent *ev = &e->xmaprequest;
 
-	if (!XGetWindowAttributes(dpy, ev->window, &wa))
+	if (wintoclient(ev->window))
 		return;
-	if (wa.override_redirect)
+	if (!prefetchtake(ev->window, &p))
+		getprops(ev->window, &p);
+	if (!p.ok || p.wa.override_redirect)
 		return;
-	if (wmclasscontains(ev->window, altbarclass, ""))
-		managealtbar(ev->window, &wa);
-	else if (!wintoclient(ev->window))
-		manage(ev->window, &wa);
+	if (p.class[0] && strstr(p.class, altbarclass))
+		managealtbar(ev->window, &p.wa);
+	else
+		manage(ev->window, &p);
 }
 
 void
@@ -1801,6 +3051,7 @@ movemouse(const Arg *arg)
 	if (!(c = selmon->sel))
 		return;
 	restack(selmon);
+	commit();
 	ocx = c->x;
 	ocy = c->y;
 	if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
@@ -1817,7 +3068,7 @@ movemouse(const Arg *arg)
 			handler[ev.type](&ev);
 			break;
 		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / xfps))
+			if ((ev.xmotion.time - lasttime) * 1000000 < c->mon->framens)
 				continue;
 			lasttime = ev.xmotion.time;
 
@@ -1836,6 +3087,7 @@ movemouse(const Arg *arg)
 				togglefloating(NULL);
 			if (!selmon->lt[selmon->sellt]->arrange || c->isfloating)
 				resize(c, nx, ny, c->w, c->h, 1);
+			commit();
 			break;
 		}
 	} while (ev.type != ButtonRelease);
@@ -1847,6 +3099,25 @@ movemouse(const Arg *arg)
 	}
 }
 
+void
+moveresizewin(Client *c, int x, int y, int w, int h)
+{
+	dequeuegeom(c);
+	XMoveResizeWindow(dpy, c->win, x, y, w, h);
+	c->cx = x;
+	c->cy = y;
+	c->cw = w;
+	c->ch = h;
+}
+
+void
+movewin(Client *c, int x, int y)
+{
+	XMoveWindow(dpy, c->win, x, y);
+	c->cx = x;
+	c->cy = y;
+}
+
 Client *
 nexttagged(Client *c) {
 	Client *walked = c->mon->clients;
@@ -1864,6 +3135,15 @@ nexttiled(Client *c)
 	return c;
 }
 
+long long
+nowns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 void
 pop(Client *c)
 {
@@ -1905,6 +3185,118 @@ prevtiled(Client *c) {
 	return r;
 }
 
+/* request the properties of w ahead of its MapRequest, anew if prefetched */
+void
+prefetch(Window w)
+{
+	if (prefetchindex(w) >= 0)
+		prefetchdrop(w);
+	else if (nprefetch == PREFETCHMAX) {
+		/* its property changes are of no interest anymore */
+		XSelectInput(dpy, prefetchwin[0], NoEventMask);
+		prefetchdrop(prefetchwin[0]);
+	}
+	prefetchwin[nprefetch] = w;
+	requestprops(w, &prefetchck[nprefetch++]);
+}
+
+/* forget the prefetch of w, leaving its replies to xcb */
+void
+prefetchdrop(Window w)
+{
+	PropCookies *ck;
+	int i;
+
+	if ((i = prefetchindex(w)) < 0)
+		return;
+	ck = &prefetchck[i];
+	xcb_discard_reply(xcon, ck->attrs.sequence);
+	xcb_discard_reply(xcon, ck->geom.sequence);
+	xcb_discard_reply(xcon, ck->netname.sequence);
+	xcb_discard_reply(xcon, ck->name.sequence);
+	xcb_discard_reply(xcon, ck->trans.sequence);
+	xcb_discard_reply(xcon, ck->class.sequence);
+	xcb_discard_reply(xcon, ck->state.sequence);
+	xcb_discard_reply(xcon, ck->wtype.sequence);
+	xcb_discard_reply(xcon, ck->normalhints.sequence);
+	xcb_discard_reply(xcon, ck->hints.sequence);
+	xcb_discard_reply(xcon, ck->pid.sequence);
+	nprefetch--;
+	memmove(&prefetchwin[i], &prefetchwin[i + 1], (nprefetch - i) * sizeof(Window));
+	memmove(&prefetchck[i], &prefetchck[i + 1], (nprefetch - i) * sizeof(PropCookies));
+}
+
+int
+prefetchindex(Window w)
+{
+	int i;
+
+	for (i = 0; i < nprefetch && prefetchwin[i] != w; i++);
+	return i < nprefetch ? i : -1;
+}
+
+/* request again the one reply of a prefetched w that a change of property a,
+ * or of the geometry if a is None, made stale */
+void
+prefetchrefresh(Window w, Atom a)
+{
+	xcb_get_property_cookie_t *pc;
+	xcb_atom_t type;
+	uint32_t len;
+	PropCookies *ck;
+	int i;
+
+	if ((i = prefetchindex(w)) < 0)
+		return;
+	ck = &prefetchck[i];
+	if (a == None) {
+		xcb_discard_reply(xcon, ck->geom.sequence);
+		ck->geom = xcb_get_geometry(xcon, w);
+		return;
+	}
+	/* sameevent() lets one name change stand for both, so both go stale */
+	if (a == netatom[NetWMName] || a == XA_WM_NAME) {
+		xcb_discard_reply(xcon, ck->netname.sequence);
+		xcb_discard_reply(xcon, ck->name.sequence);
+		ck->netname = xcb_get_property(xcon, 0, w, netatom[NetWMName], XCB_GET_PROPERTY_TYPE_ANY, 0, TEXTPROPLEN);
+		ck->name = xcb_get_property(xcon, 0, w, XA_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, 0, TEXTPROPLEN);
+		return;
+	}
+	if (a == XA_WM_TRANSIENT_FOR)
+		pc = &ck->trans, type = XA_WINDOW, len = 1;
+	else if (a == XA_WM_CLASS)
+		pc = &ck->class, type = XA_STRING, len = 128;
+	else if (a == netatom[NetWMState])
+		pc = &ck->state, type = XA_ATOM, len = 1;
+	else if (a == netatom[NetWMWindowType])
+		pc = &ck->wtype, type = XA_ATOM, len = 1;
+	else if (a == XA_WM_NORMAL_HINTS)
+		pc = &ck->normalhints, type = XA_WM_SIZE_HINTS, len = 18;
+	else if (a == XA_WM_HINTS)
+		pc = &ck->hints, type = XA_WM_HINTS, len = 9;
+	else
+		return; /* not read by manage() */
+	xcb_discard_reply(xcon, pc->sequence);
+	*pc = xcb_get_property(xcon, 0, w, a, type, 0, len);
+}
+
+/* collect the prefetched properties of w into p, if there are any */
+int
+prefetchtake(Window w, Props *p)
+{
+	int i;
+
+	if ((i = prefetchindex(w)) < 0)
+		return 0;
+	collectprops(&prefetchck[i], p);
+	/* manage() selects what it needs itself */
+	XSelectInput(dpy, w, NoEventMask);
+	nprefetch--;
+	memmove(&prefetchwin[i], &prefetchwin[i + 1], (nprefetch - i) * sizeof(Window));
+	memmove(&prefetchck[i], &prefetchck[i + 1], (nprefetch - i) * sizeof(PropCookies));
+	return 1;
+}
+
 void
 propertynotify(XEvent *e)
 {
@@ -1912,6 +3304,7 @@ propertynotify(XEvent *e)
 	Window trans;
 	XPropertyEvent *ev = &e->xproperty;
 
+	prefetchrefresh(ev->window, ev->atom);
 	if ((ev->window == root) && (ev->atom == XA_WM_NAME)){
 		updatestatus();
 	//	updategapstatus();
@@ -2010,9 +3403,44 @@ recttomon(int x, int y, int w, int h)
 	return r;
 }
 
+/* send every request getprops() needs without waiting for any reply */
+void
+requestprops(Window w, PropCookies *ck)
+{
+	xcb_res_client_id_spec_t spec = { w, XCB_RES_CLIENT_ID_MASK_LOCAL_CLIENT_PID };
+
+	ck->attrs = xcb_get_window_attributes(xcon, w);
+	ck->geom = xcb_get_geometry(xcon, w);
+	ck->netname = xcb_get_property(xcon, 0, w, netatom[NetWMName], XCB_GET_PROPERTY_TYPE_ANY, 0, TEXTPROPLEN);
+	ck->name = xcb_get_property(xcon, 0, w, XA_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, 0, TEXTPROPLEN);
+	ck->trans = xcb_get_property(xcon, 0, w, XA_WM_TRANSIENT_FOR, XA_WINDOW, 0, 1);
+	ck->class = xcb_get_property(xcon, 0, w, XA_WM_CLASS, XA_STRING, 0, 128);
+	ck->state = xcb_get_property(xcon, 0, w, netatom[NetWMState], XA_ATOM, 0, 1);
+	ck->wtype = xcb_get_property(xcon, 0, w, netatom[NetWMWindowType], XA_ATOM, 0, 1);
+	ck->normalhints = xcb_get_property(xcon, 0, w, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 0, 18);
+	ck->hints = xcb_get_property(xcon, 0, w, XA_WM_HINTS, XA_WM_HINTS, 0, 9);
+	ck->pid = xcb_res_query_client_ids(xcon, 1, &spec);
+}
+
 void
 resize(Client *c, int x, int y, int w, int h, int interact)
 {
+	if (c->anim.frames && !c->anim.ghost) {
+		if (!interact) {
+			animretarget(c, x, y, w, h);
+			return;
+		}
+		/* the pointer wins over the tween, which completes on the next tick */
+		c->anim.fx = x;
+		c->anim.fy = y;
+		c->anim.fw = w;
+		c->anim.fh = h;
+		c->anim.resetpos = 0;
+		c->anim.start = 0;
+	} else if (transition && !interact && ISVISIBLE(c)) {
+		animlayout(c, x, y, w, h);
+		return;
+	}
 	if (applysizehints(c, &x, &y, &w, &h, interact))
 		resizeclient(c, x, y, w, h);
 }
@@ -2020,18 +3448,15 @@ resize(Client *c, int x, int y, int w, int h, int interact)
 void
 resizeclient(Client *c, int x, int y, int w, int h)
 {
-	XWindowChanges wc;
-
   /*
   unsigned int n;
   unsigned int gapoffset;
   unsigned int gapincr;
   Client *nbc;*/
-	c->oldx = c->x; c->x = wc.x = x;
-	c->oldy = c->y; c->y = wc.y = y;
-	c->oldw = c->w; c->w = wc.width = w;
-	c->oldh = c->h; c->h = wc.height = h;
-	wc.border_width = c->bw;
+	c->oldx = c->x; c->x = x;
+	c->oldy = c->y; c->y = y;
+	c->oldw = c->w; c->w = w;
+	c->oldh = c->h; c->h = h;
 
 
 
@@ -2065,11 +3490,12 @@ resizeclient(Client *c, int x, int y, int w, int h)
 */
 
 
-	XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
-	configure(c);
-	XSync(dpy, False);
-
-
+	/* the server learns about it in flushgeom() */
+	if (!c->queued) {
+		c->queued = 1;
+		c->qnext = geomq;
+		geomq = c;
+	}
 }
 
 void
@@ -2084,6 +3510,7 @@ resizemouse(const Arg *arg)
 	if (!(c = selmon->sel))
 		return;
 	restack(selmon);
+	commit();
 	ocx = c->x;
 	ocy = c->y;
 	if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
@@ -2099,7 +3526,7 @@ resizemouse(const Arg *arg)
 			handler[ev.type](&ev);
 			break;
 		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / xfps))
+			if ((ev.xmotion.time - lasttime) * 1000000 < c->mon->framens)
 				continue;
 			lasttime = ev.xmotion.time;
 
@@ -2114,6 +3541,7 @@ resizemouse(const Arg *arg)
 			}
 			if (!selmon->lt[selmon->sellt]->arrange || c->isfloating)
 				resize(c, c->x, c->y, nw, nh, 1);
+			commit();
 			break;
 		}
 	} while (ev.type != ButtonRelease);
@@ -2129,11 +3557,18 @@ resizemouse(const Arg *arg)
 
 void
 restack(Monitor *m)
+{
+	m->dirty |= DirtyRestack | DirtyBar;
+}
+
+void
+restackmon(Monitor *m)
 {
 	Client *c;
 	XEvent ev;
 	XWindowChanges wc;
 
+	flushgeom();
 	drawbar(m);
 	if (!m->sel)
 		return;
@@ -2150,22 +3585,35 @@ restack(Monitor *m)
 	}
 	XSync(dpy, False);
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
+	dropbatched(EnterNotify);
 if (m == selmon && (m->tagset[m->seltags] & m->sel->tags) && selmon->lt[selmon->sellt] != &layouts[2])
 		warp(m->sel);
 }
 
-/*
 void
 run(void)
 {
 	int event_count = 0;
 	const int MAX_EVENTS = 10;
 	struct epoll_event events[MAX_EVENTS];
+	Monitor *m;
 
 	XSync(dpy, False);
 
 	// main event loop
 	while (running) {
+		/* whatever the last wakeup (or setup) left dirty; subscribers
+		 * hear about the committed state once per wakeup */
+		commit();
+		/* commit() may sync with the server, which moves events off the
+		 * socket into Xlib's queue where epoll cannot see them */
+		while (running && XPending(dpy)) {
+			handlexqueue();
+			commit();
+		}
+		ipc_send_events(mons, &lastselmon, selmon);
+		XFlush(dpy);
+		procbury();
 		event_count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
 
 		for (int i = 0; i < event_count; i++) {
@@ -2176,52 +3624,26 @@ run(void)
 				// -1 means EPOLLHUP
 				if (handlexevent(events + i) == -1)
 					return;
+			} else if ((m = clocktomon(event_fd))) {
+				handleclock(m);
 			} else if (event_fd == ipc_get_sock_fd()) {
 				ipc_handle_socket_epoll_event(events + i);
-			} else if (ipc_is_client_registered(event_fd)){
+			} else if (ipc_is_client_registered(event_fd)) {
 				if (ipc_handle_client_epoll_event(events + i, mons, &lastselmon, selmon,
-							tags, LENGTH(tags), layouts, LENGTH(layouts)) < 0) {
+							tags, LENGTH(tags), layouts, LENGTH(layouts)) < 0)
 					fprintf(stderr, "Error handling IPC event on fd %d\n", event_fd);
-				}
+			} else if (event_fd == status_fd) {
+				handlestatus();
+			} else if (modtick(event_fd)) {
+				;
+			} else if (procexited(event_fd)) {
+				;
 			} else {
 				fprintf(stderr, "Got event from unknown fd %d, ptr %p, u32 %d, u64 %lu",
 						event_fd, events[i].data.ptr, events[i].data.u32,
 						events[i].data.u64);
 				fprintf(stderr, " with events %d\n", events[i].events);
-				return;
-			}
-		}
-	}
-}
-*/
-
-void
-run(void)
-{
-	int event_count = 0;
-	const int MAX_EVENTS = 10;
-	struct epoll_event events[MAX_EVENTS];
-
-	XSync(dpy, False);
-
-	// main event loop
-	while (running) {
-		event_count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
-
-		for (int i = 0; i < event_count; i++) {
-			int event_fd = events[i].data.fd;
-			DEBUG("Got event from fd %d\n", event_fd);
-
-			if (event_fd == dpy_fd) {
-				// -1 means EPOLLHUP
-				if (handlexevent(events + i) == -1)
-					return;
-        } else {
-				fprintf(stderr, "Got event from unknown fd %d, ptr %p, u32 %d, u64 %lu",
-						event_fd, events[i].data.ptr, events[i].data.u32,
-						events[i].data.u64);
-				fprintf(stderr, " with events %d\n", events[i].events);
-				return;
+				continue;
 			}
 		}
 	}
@@ -2233,30 +3655,54 @@ run(void)
 void
 scan(void)
 {
-	unsigned int i, num;
-	Window d1, d2, *wins = NULL;
-	XWindowAttributes wa;
-
-	if (XQueryTree(dpy, root, &d1, &d2, &wins, &num)) {
+	unsigned int i, num;
+	Window d1, d2, *wins = NULL;
+	PropCookies *ck;
+	xcb_get_property_cookie_t *stck;
+	xcb_get_property_reply_t *r;
+	xcb_generic_error_t *e = NULL;
+	Props *p;
+	long *state;
+	long long start = nowns();
+
+	if (XQueryTree(dpy, root, &d1, &d2, &wins, &num) && num) {
+		ck = ecalloc(num, sizeof(PropCookies));
+		stck = ecalloc(num, sizeof(xcb_get_property_cookie_t));
+		p = ecalloc(num, sizeof(Props));
+		state = ecalloc(num, sizeof(long));
+		/* every request for every window goes out before the first reply
+		 * is waited for */
 		for (i = 0; i < num; i++) {
-			if (!XGetWindowAttributes(dpy, wins[i], &wa)
-			|| wa.override_redirect || XGetTransientForHint(dpy, wins[i], &d1))
-				continue;
-			if (wmclasscontains(wins[i], altbarclass, ""))
-				managealtbar(wins[i], &wa);
-			else if (wa.map_state == IsViewable || getstate(wins[i]) == IconicState)
-				manage(wins[i], &wa);
+			requestprops(wins[i], &ck[i]);
+			stck[i] = xcb_get_property(xcon, 0, wins[i], wmatom[WMState], wmatom[WMState], 0, 2);
 		}
-		for (i = 0; i < num; i++) { /* now the transients */
-			if (!XGetWindowAttributes(dpy, wins[i], &wa))
+		for (i = 0; i < num; i++) {
+			collectprops(&ck[i], &p[i]);
+			r = xcb_get_property_reply(xcon, stck[i], &e);
+			free(e);
+			state[i] = r && r->format == 32 && r->value_len ? *(uint32_t *)xcb_get_property_value(r) : -1;
+			free(r);
+		}
+		for (i = 0; i < num; i++) {
+			if (!p[i].ok || p[i].wa.override_redirect || p[i].hastrans)
 				continue;
-			if (XGetTransientForHint(dpy, wins[i], &d1)
-			&& (wa.map_state == IsViewable || getstate(wins[i]) == IconicState))
-				manage(wins[i], &wa);
+			if (p[i].class[0] && strstr(p[i].class, altbarclass))
+				managealtbar(wins[i], &p[i].wa);
+			else if (p[i].wa.map_state == IsViewable || state[i] == IconicState)
+				manage(wins[i], &p[i]);
 		}
-		if (wins)
-			XFree(wins);
+		for (i = 0; i < num; i++) /* now the transients */
+			if (p[i].ok && p[i].hastrans
+			&& (p[i].wa.map_state == IsViewable || state[i] == IconicState))
+				manage(wins[i], &p[i]);
+		free(ck);
+		free(stck);
+		free(p);
+		free(state);
+		fprintf(stderr, "dwm: scanned %u windows in %lld us\n", num, (nowns() - start) / 1000);
 	}
+	if (wins)
+		XFree(wins);
 }
 
 void
@@ -2288,6 +3734,7 @@ sendmon(Client *c, Monitor *m)
 	if (c->mon == m)
 		return;
 	unfocus(c, 1);
+	arrange(c->mon);
 	detach(c);
 	detachstack(c);
 	c->mon = m;
@@ -2295,7 +3742,7 @@ sendmon(Client *c, Monitor *m)
 	attachaside(c);
 	attachstack(c);
 	focus(NULL);
-	arrange(NULL);
+	arrange(m);
 }
 
 void
@@ -2597,34 +4044,18 @@ setmfact(const Arg *arg)
 */
 
 
-int clientcount()
-{
-	int n;
-	Client *c;
-	for (n = 0, c = nexttiled(selmon->clients); c; c = nexttiled(c->next), n++);
-	return n;
-}
-
 void
 setmfact(const Arg *arg)
 {
 	float f;
-	int tmpanim = 0;
+
 	if (!arg || !selmon->lt[selmon->sellt]->arrange)
 		return;
 	f = arg->f < 1.0 ? arg->f + selmon->mfact : arg->f - 1.0;
 	if (f < 0.1 || f > 0.9)
 		return;
 	selmon->mfact = selmon->pertag->mfacts[selmon->pertag->curtag] = f;
-
-	if (animated && clientcount() > 2) {
-		tmpanim = 1;
-		animated = 0;
-	}
-
 	arrange(selmon);
-	if (tmpanim)
-		animated = 1;
 }
 
 
@@ -2640,17 +4071,27 @@ setup(void)
 	/* clean up any zombies immediately */
 	sigchld(0);
 
+	for (i = 0; i <= EASESTEPS; i++)
+		easetab[i] = easeOutQuint((double)i / EASESTEPS);
+	compilerules();
+
 	/* init screen */
 	screen = DefaultScreen(dpy);
 	sw = DisplayWidth(dpy, screen);
 	sh = DisplayHeight(dpy, screen);
 	root = RootWindow(dpy, screen);
 	xinitvisual();
-	drw = drw_create(dpy, screen, root, sw, sh, visual, depth, cmap);
+	/* bars draw into their own buffers, see drawbarmon() */
+	drw = drw_create(dpy, screen, root, 1, 1, visual, depth, cmap);
 	if (!drw_fontset_create(drw, fonts, LENGTH(fonts)))
 		die("no fonts could be loaded.");
 	lrpad = drw->fonts->h;
 	bh = usealtbar ? 0 : drw->fonts->h + 2;
+#ifdef XRANDR
+	/* a mode switch changes the refresh rate, not necessarily the size */
+	if ((randr = XRRQueryExtension(dpy, &rrevbase, &i)))
+		XRRSelectInput(dpy, root, RRScreenChangeNotifyMask);
+#endif /* XRANDR */
 	updategeom();
 	/* init atoms */
 	utf8string = XInternAtom(dpy, "UTF8_STRING", False);
@@ -2728,9 +4169,12 @@ setupepoll(void)
 		exit(1);
 	}
 
-//	if (ipc_init(ipcsockpath, epoll_fd, ipccommands, LENGTH(ipccommands)) < 0) {
-//		fputs("Failed to initialize IPC\n", stderr);
-//	}
+	statusinit();
+	modulesinit();
+
+	if (ipc_init(ipcsockpath, epoll_fd, ipccommands, LENGTH(ipccommands)) < 0) {
+		fputs("Failed to initialize IPC\n", stderr);
+	}
 }
 
 void
@@ -2757,14 +4201,17 @@ showhide(Client *c)
 			c->y = c->mon->wy + (c->mon->wh / 2 - HEIGHT(c) / 2);
 		}
 		/* show clients top down */
-		XMoveWindow(dpy, c->win, c->x, c->y);
+		if (c->anim.ghost)
+			c->anim.frames = c->anim.ghost = 0;
+		movewin(c, c->x, c->y);
 		if (!c->mon->lt[c->mon->sellt]->arrange || c->isfloating)
 			resize(c, c->x, c->y, c->w, c->h, 0);
 		showhide(c->snext);
 	} else {
 		/* hide clients bottom up */
 		showhide(c->snext);
-		XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+		if (!c->anim.ghost || !c->anim.frames)
+			movewin(c, WIDTH(c) * -2, c->y);
 	}
 }
 
@@ -2909,21 +4356,11 @@ togglebar(const Arg *arg)
 void
 togglebar(const Arg *arg)
 {
-	int tmpnoanim;
-	if (animated && clientcount() > 6) {
-		animated = 0;
-		tmpnoanim = 1;
-	} else {
-		tmpnoanim = 0;
-	}
-
 	selmon->showbar = selmon->pertag->showbars[selmon->pertag->curtag] = !selmon->showbar;
 	updatebarpos(selmon);
 	arrange(selmon);
 	XMoveResizeWindow(dpy, selmon->barwin, selmon->wx, selmon->by, selmon->ww, selmon->bh);
 	XMoveResizeWindow(dpy, selmon->traywin, selmon->tx, selmon->by, selmon->tw, selmon->bh);
-	if (tmpnoanim)
-		animated = 1;
 }
 
 /*
@@ -2963,15 +4400,15 @@ hide(Client *c) {
 	if (!c || HIDDEN(c))
 		return;
 
-	int x, y, wi, h;
-	x = c->x;
-	y = c->y;
-	wi = c->w;
-	h = c->h;
-
+	/* the window is put back at its position only after it got unmapped */
 	if (animated)
-		animateclient(c, c->x, bh - c->h + 40, 0, 0, 10, 0);
+		animate(c, c->x, bh - c->h + 40, 0, 0, 10, 1, hidewin);
+	else
+		hidewin(c);
+}
 
+void
+hidewin(Client *c) {
 	Window w = c->win;
 	static XWindowAttributes ra, ca;
 
@@ -2987,7 +4424,6 @@ hide(Client *c) {
 	XSelectInput(dpy, root, ra.your_event_mask);
 	XSelectInput(dpy, w, ca.your_event_mask);
 	XUngrabServer(dpy);
-	resize(c, x, y, wi, h, 0);
 
 	focus(c->snext);
 	arrange(c->mon);
@@ -3041,6 +4477,7 @@ viewtoleft(const Arg *arg) {
 		return;
 	if(__builtin_popcount(selmon->tagset[selmon->seltags] & TAGMASK) == 1
 	&& selmon->tagset[selmon->seltags] > 1) {
+		animslideout(selmon, -1);
 		selmon->seltags ^= 1; /* toggle sel tagset */
 		selmon->tagset[selmon->seltags] = selmon->tagset[selmon->seltags ^ 1] >> 1;
 		selmon->pertag->prevtag = selmon->pertag->curtag;
@@ -3075,6 +4512,7 @@ viewtoright(const Arg *arg) {
 
 	if(__builtin_popcount(selmon->tagset[selmon->seltags] & TAGMASK) == 1
 	&& selmon->tagset[selmon->seltags] & (TAGMASK >> 1)) {
+		animslideout(selmon, 1);
 		selmon->seltags ^= 1; /* toggle sel tagset */
 		selmon->tagset[selmon->seltags] = selmon->tagset[selmon->seltags ^ 1] << 1;
 
@@ -3171,10 +4609,6 @@ void changesnap(Client *c, int snapmode) {
 void
 animleft(const Arg *arg) {
 
-	Client *c;
-	Client *tempc;
-	int tmpcounter = 0;
-
 	// windows like behaviour in floating layout
 	if (selmon->sel && NULL == selmon->lt[selmon->sellt]->arrange) {
 		XSetWindowBorder(dpy, selmon->sel->win, scheme[SchemeSel][ColBg].pixel);
@@ -3185,28 +4619,12 @@ animleft(const Arg *arg) {
 	if (selmon->pertag->curtag == 1 || selmon->pertag->curtag == 0)
 		return;
 
-	if (animated) {
-		for(tempc = selmon->clients; tempc; tempc = tempc->next) {
-			if (tempc->tags & 1 << selmon->pertag->curtag - 2 && !tempc->isfloating && selmon->pertag &&
-				selmon->pertag->ltidxs[selmon->pertag->curtag - 1][0]->arrange != NULL) {
-				if (!tmpcounter) {
-					tmpcounter = 1;
-					tempc->x = tempc->x - 200;
-				}
-			}
-		}
-	}
-
 	viewtoleft(arg);
 }
 
 void
 animright(const Arg *arg) {
 
-	Client *c;
-	Client *tempc;
-	int tmpcounter = 0;
-
 	if (selmon->sel && NULL == selmon->lt[selmon->sellt]->arrange) {
           XSetWindowBorder(dpy, selmon->sel->win,
                            scheme[SchemeSel][ColBorder].pixel);
@@ -3217,18 +4635,6 @@ animright(const Arg *arg) {
 	if (selmon->pertag->curtag >= 20 || selmon->pertag->curtag == 0)
 		return;
 
-	if (animated) {
-		for(tempc = selmon->clients; tempc; tempc = tempc->next) {
-			if (tempc->tags & 1 << selmon->pertag->curtag && !tempc->isfloating && selmon->pertag &&
-				selmon->pertag->ltidxs[selmon->pertag->curtag + 1][0]->arrange != NULL) {
-				if (!tmpcounter) {
-					tmpcounter = 1;
-					tempc->x = tempc->x + 200;
-				}
-			}
-		}
-	}
-
 	viewtoright(arg);
 }
 
@@ -3331,6 +4737,8 @@ unfocus(Client *c, int setfocus)
 {
 	if (!c)
 		return;
+	if (c == xfocus)
+		xfocus = NULL;
 	grabbuttons(c, 0);
 	XSetWindowBorder(dpy, c->win, scheme[SchemeNorm][ColBorder].pixel);
 	if (setfocus) {
@@ -3354,6 +4762,8 @@ unmanage(Client *c, int destroyed)
 
 	Client *s = swallowingclient(c->win);
 	if (s) {
+		detachswallow(s);
+		dequeuegeom(s->swallowing);
 		free(s->swallowing);
 		s->swallowing = NULL;
 		arrange(m);
@@ -3363,6 +4773,12 @@ unmanage(Client *c, int destroyed)
 
 	detach(c);
 	detachstack(c);
+	detachhash(c);
+	if (c->isterminal && c->pid)
+		detachterm(c);
+	dequeuegeom(c);
+	if (c == xfocus)
+		xfocus = NULL;
 	if (!destroyed) {
 		wc.border_width = c->oldbw;
 		XGrabServer(dpy); /* avoid race conditions */
@@ -3374,6 +4790,7 @@ unmanage(Client *c, int destroyed)
 		XSetErrorHandler(xerror);
 		XUngrabServer(dpy);
 	}
+	ipc_log_client_removed(c);
 	free(c);
 
 	if (!s) {
@@ -3561,7 +4978,9 @@ updategeom(void)
 	if (dirty) {
 		selmon = mons;
 		selmon = wintomon(root);
+		ipc_log_monitors_changed();
 	}
+	updaterefresh();
 	return dirty;
 }
 
@@ -3581,15 +5000,72 @@ updatenumlockmask(void)
 	XFreeModifiermap(modmap);
 }
 
+/* take the frame period of each monitor from the fastest CRTC showing its
+ * centre, or assume xfps where RandR has nothing to say */
+void
+updaterefresh(void)
+{
+	Monitor *m;
+#ifdef XRANDR
+	XRRScreenResources *res;
+	XRRCrtcInfo *ci;
+	XRRModeInfo *mi;
+	double vtotal;
+	long ns;
+	int i, j, cx, cy;
+
+	for (m = mons; m; m = m->next)
+		m->framens = 0;
+	if (randr && (res = XRRGetScreenResourcesCurrent(dpy, root))) {
+		for (i = 0; i < res->ncrtc; i++) {
+			if (!(ci = XRRGetCrtcInfo(dpy, res, res->crtcs[i])))
+				continue;
+			for (j = 0, mi = NULL; ci->mode != None && j < res->nmode; j++)
+				if (res->modes[j].id == ci->mode)
+					mi = &res->modes[j];
+			vtotal = mi ? mi->vTotal : 0;
+			if (mi && mi->modeFlags & RR_DoubleScan)
+				vtotal *= 2;
+			if (mi && mi->modeFlags & RR_Interlace)
+				vtotal /= 2;
+			if (mi && mi->dotClock && mi->hTotal && vtotal) {
+				ns = 1e9 * mi->hTotal * vtotal / mi->dotClock;
+				for (m = mons; m; m = m->next) {
+					cx = m->mx + m->mw / 2;
+					cy = m->my + m->mh / 2;
+					if (cx >= ci->x && cx < ci->x + (int)ci->width
+					&& cy >= ci->y && cy < ci->y + (int)ci->height
+					&& (!m->framens || ns < m->framens))
+						m->framens = ns;
+				}
+			}
+			XRRFreeCrtcInfo(ci);
+		}
+		XRRFreeScreenResources(res);
+	}
+#endif /* XRANDR */
+	for (m = mons; m; m = m->next)
+		if (m->framens <= 0)
+			m->framens = 1000000000 / xfps;
+}
+
 void
 updatesizehints(Client *c)
 {
 	long msize;
 	XSizeHints size;
 
-	if (!XGetWMNormalHints(dpy, c->win, &size, &msize))
-		/* size is uninitialized, ensure that size.flags aren't used */
-		size.flags = PSize;
+	setsizehints(c, XGetWMNormalHints(dpy, c->win, &size, &msize) ? &size : NULL);
+}
+
+void
+setsizehints(Client *c, const XSizeHints *hints)
+{
+	/* ensure that size.flags aren't used without hints */
+	XSizeHints size = { .flags = PSize };
+
+	if (hints)
+		size = *hints;
 	if (size.flags & PBaseSize) {
 		c->basew = size.base_width;
 		c->baseh = size.base_height;
@@ -3624,6 +5100,252 @@ updatesizehints(Client *c)
 	c->isfixed = (c->maxw && c->maxh && c->maxw == c->minw && c->maxh == c->minh);
 }
 
+void
+handlestatus(void)
+{
+	char msg[512];
+	ssize_t n;
+
+	while ((n = recv(status_fd, msg, sizeof(msg) - 1, 0)) > 0) {
+		msg[n] = '\0';
+		if (msg[n - 1] == '\n')
+			msg[n - 1] = '\0';
+		statusmsg(msg);
+	}
+}
+
+/* a status socket on the epoll set; a status that cannot be set that way
+ * still can through WM_NAME */
+void
+statusinit(void)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct epoll_event ev = { .events = EPOLLIN };
+
+	if (strlen(statussockpath) >= sizeof(addr.sun_path))
+		return;
+	strcpy(addr.sun_path, statussockpath);
+	if ((status_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+		return;
+	unlink(statussockpath);
+	ev.data.fd = status_fd;
+	if (bind(status_fd, (struct sockaddr *)&addr, sizeof(addr))
+	|| epoll_ctl(epoll_fd, EPOLL_CTL_ADD, status_fd, &ev)) {
+		fprintf(stderr, "dwm: cannot listen on %s: %s\n", statussockpath, strerror(errno));
+		close(status_fd);
+		status_fd = -1;
+	}
+}
+
+/* name\ttext or name\tfg\tbg\ttext, an empty text removes the segment */
+void
+statusmsg(char *msg)
+{
+	char *f[4];
+	unsigned int n;
+	Clr *scm = scheme[SchemeNorm];
+
+	for (n = 1, f[0] = msg; n < LENGTH(f) && (f[n] = strchr(f[n - 1], '\t')); n++)
+		*f[n]++ = '\0';
+	if ((n != 2 && n != 4) || strlen(f[0]) >= sizeof(segs->name))
+		return;
+	if (n == 4 && !(scm = statusscheme(f[1], f[2])))
+		return;
+	setsegment(f[0], scm, f[n - 1]);
+}
+
+void
+setsegment(const char *name, Clr *scm, const char *text)
+{
+	unsigned int i;
+	Segment *s;
+
+	for (i = 0; i < nsegs && strcmp(segs[i].name, name); i++);
+	s = &segs[i];
+	if (!*text) {
+		if (i == nsegs)
+			return;
+		memmove(s, s + 1, (--nsegs - i) * sizeof(Segment));
+		drawbar(selmon);
+		return;
+	}
+	if (i == nsegs) {
+		if (nsegs == STATUSSEGS)
+			return;
+		nsegs++;
+		strncpy(s->name, name, sizeof(s->name) - 1);
+		s->id = ++lastsegid;
+		s->w = -1;
+	} else if (s->scheme == scm && !strncmp(s->text, text, sizeof(s->text) - 1)) {
+		return;
+	}
+	strncpy(s->text, text, sizeof(s->text) - 1);
+	s->scheme = scm;
+	if (statusmon && s->w == (int)TEXTW(s->text) && s->x >= statusmin) {
+		s->dirty = 1;
+		statusmon->dirty |= DirtyStatus;
+	} else {
+		drawbar(selmon);
+	}
+}
+
+/* a scheme for #rrggbb colors, shared by the segments using them */
+Clr *
+statusscheme(const char *fg, const char *bg)
+{
+	const char *c[3] = { fg, bg, bg };
+	const unsigned int a[3] = { OPAQUE, baralpha, borderalpha };
+	unsigned int i, j;
+
+	for (i = 0; i < 2; i++) {
+		if (strlen(c[i]) != 7 || c[i][0] != '#')
+			return NULL;
+		for (j = 1; j < 7; j++)
+			if (!isxdigit((unsigned char)c[i][j]))
+				return NULL;
+	}
+	for (i = 0; i < nstatusschemes; i++)
+		if (!strcmp(statusschemes[i].fg, fg) && !strcmp(statusschemes[i].bg, bg))
+			return statusschemes[i].scheme;
+	if (nstatusschemes == STATUSSCHEMES)
+		return scheme[SchemeNorm];
+	strcpy(statusschemes[i].fg, fg);
+	strcpy(statusschemes[i].bg, bg);
+	statusschemes[i].scheme = drw_scm_create(drw, c, a, 3);
+	nstatusschemes++;
+	return statusschemes[i].scheme;
+}
+
+/* the whole of a file kept open, read again from the start */
+ssize_t
+modread(const char *path, ModState *st, char *buf, size_t size)
+{
+	ssize_t n;
+
+	if (st->fd == -1 && (st->fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		return -1;
+	if ((n = pread(st->fd, buf, size - 1, 0)) < 0)
+		return -1;
+	buf[n] = '\0';
+	return n;
+}
+
+int
+modbattery(const char *arg, ModState *st, char *text, size_t size)
+{
+	char buf[1024], *cap, *stat;
+
+	if (modread(arg, st, buf, sizeof(buf)) < 0
+	|| !(cap = strstr(buf, "POWER_SUPPLY_CAPACITY=")))
+		return 0;
+	stat = strstr(buf, "POWER_SUPPLY_STATUS=Charging");
+	snprintf(text, size, "bat %d%%%s", atoi(cap + 22), stat ? "+" : "");
+	return 1;
+}
+
+int
+modclock(const char *arg, ModState *st, char *text, size_t size)
+{
+	time_t t = time(NULL);
+	struct tm tm;
+
+	return localtime_r(&t, &tm) && strftime(text, size, arg, &tm);
+}
+
+/* busy time since the last tick; a and b hold idle and total jiffies */
+int
+modcpu(const char *arg, ModState *st, char *text, size_t size)
+{
+	char buf[256];
+	unsigned long long v[8] = {0}, idle, total = 0;
+	int i;
+
+	if (modread(arg, st, buf, sizeof(buf)) < 0
+	|| sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+	          &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) < 4)
+		return 0;
+	for (i = 0; i < 8; i++)
+		total += v[i];
+	idle = v[3] + v[4];
+	if (total == st->b)
+		return 0;
+	snprintf(text, size, "cpu %llu%%", 100 - 100 * (idle - st->a) / (total - st->b));
+	st->a = idle;
+	st->b = total;
+	return 1;
+}
+
+int
+modmem(const char *arg, ModState *st, char *text, size_t size)
+{
+	char buf[512], *p;
+	unsigned long long total, avail;
+
+	if (modread(arg, st, buf, sizeof(buf)) < 0
+	|| !(p = strstr(buf, "MemTotal:")) || sscanf(p + 9, "%llu", &total) != 1
+	|| !(p = strstr(buf, "MemAvailable:")) || sscanf(p + 13, "%llu", &avail) != 1
+	|| !total)
+		return 0;
+	snprintf(text, size, "mem %llu%%", 100 * (total - avail) / total);
+	return 1;
+}
+
+/* the next multiple of interval seconds, on the wall clock */
+void
+modarm(ModState *st, unsigned int interval)
+{
+	struct itimerspec its = {0};
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	its.it_value.tv_sec = (now.tv_sec / interval + 1) * interval;
+	/* a step of the wall clock wakes the timer with ECANCELED, so a clock
+	 * set back does not wait out the old deadline */
+	timerfd_settime(st->tfd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL);
+}
+
+void
+modulesinit(void)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	unsigned int i;
+
+	for (i = 0; i < LENGTH(modules); i++) {
+		modstate[i].fd = -1;
+		modstate[i].tfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+		ev.data.fd = modstate[i].tfd;
+		if (modstate[i].tfd == -1 || !modules[i].interval
+		|| epoll_ctl(epoll_fd, EPOLL_CTL_ADD, modstate[i].tfd, &ev)) {
+			if (modstate[i].tfd != -1)
+				close(modstate[i].tfd);
+			modstate[i].tfd = -1;
+			continue;
+		}
+		/* a first reading now, which also puts the segments in order */
+		modtick(modstate[i].tfd);
+	}
+}
+
+/* whether fd is the timer of a module, which has been run then */
+int
+modtick(int fd)
+{
+	char text[256];
+	uint64_t expirations;
+	unsigned int i;
+
+	for (i = 0; i < LENGTH(modules) && modstate[i].tfd != fd; i++);
+	if (i == LENGTH(modules) || fd == -1)
+		return 0;
+	/* expired or cancelled by a clock step, either way the module runs
+	 * and the timer is armed again from the clock as it is now */
+	read(fd, &expirations, sizeof(expirations));
+	if (modules[i].func(modules[i].arg, &modstate[i], text, sizeof(text)))
+		setsegment(modules[i].name, scheme[SchemeNorm], text);
+	modarm(&modstate[i], modules[i].interval);
+	return 1;
+}
+
 void
 updatestatus(void)
 {
@@ -3644,27 +5366,42 @@ updategapstatus(void)
 
 void
 updatetitle(Client *c)
+{
+	char name[sizeof(c->name)];
+
+	if (!gettextprop(c->win, netatom[NetWMName], name, sizeof name))
+		gettextprop(c->win, XA_WM_NAME, name, sizeof name);
+	settitle(c, name);
+}
+
+void
+settitle(Client *c, const char *name)
 {
 	char oldname[sizeof(c->name)];
 	strcpy(oldname, c->name);
 
-	if (!gettextprop(c->win, netatom[NetWMName], c->name, sizeof c->name))
-		gettextprop(c->win, XA_WM_NAME, c->name, sizeof c->name);
+	snprintf(c->name, sizeof c->name, "%s", name);
 	if (c->name[0] == '\0') /* hack to mark broken clients */
 		strcpy(c->name, broken);
 
+	if (strcmp(oldname, c->name) != 0)
+		ipc_log_client_title(c);
 	for (Monitor *m = mons; m; m = m->next) {
-		//if (m->sel == c && strcmp(oldname, c->name) != 0)
-			//ipc_focused_title_change_event(m->num, c->win, oldname, c->name);
+		if (m->sel == c && strcmp(oldname, c->name) != 0)
+			ipc_focused_title_change_event(m->num, c->win, oldname, c->name);
 	}
 }
 
 void
 updatewindowtype(Client *c)
 {
-	Atom state = getatomprop(c, netatom[NetWMState]);
-	Atom wtype = getatomprop(c, netatom[NetWMWindowType]);
+	setwindowtype(c, getatomprop(c, netatom[NetWMState]),
+		getatomprop(c, netatom[NetWMWindowType]));
+}
 
+void
+setwindowtype(Client *c, Atom state, Atom wtype)
+{
 	if (state == netatom[NetWMFullscreen])
 		setfullscreen(c, 1);
 	if (wtype == netatom[NetWMWindowTypeDialog])
@@ -3677,19 +5414,25 @@ updatewmhints(Client *c)
 	XWMHints *wmh;
 
 	if ((wmh = XGetWMHints(dpy, c->win))) {
-		if (c == selmon->sel && wmh->flags & XUrgencyHint) {
-			wmh->flags &= ~XUrgencyHint;
-			XSetWMHints(dpy, c->win, wmh);
-		} else
-			c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
-		if (wmh->flags & InputHint)
-			c->neverfocus = !wmh->input;
-		else
-			c->neverfocus = 0;
+		setwmhints(c, wmh);
 		XFree(wmh);
 	}
 }
 
+void
+setwmhints(Client *c, XWMHints *wmh)
+{
+	if (c == selmon->sel && wmh->flags & XUrgencyHint) {
+		wmh->flags &= ~XUrgencyHint;
+		XSetWMHints(dpy, c->win, wmh);
+	} else
+		c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
+	if (wmh->flags & InputHint)
+		c->neverfocus = !wmh->input;
+	else
+		c->neverfocus = 0;
+}
+
 void
 view(const Arg *arg)
 {
@@ -3756,16 +5499,21 @@ warp(const Client *c)
 pid_t
 winpid(Window w)
 {
-	pid_t result = 0;
+	xcb_res_client_id_spec_t spec = { w, XCB_RES_CLIENT_ID_MASK_LOCAL_CLIENT_PID };
+
+	return replypid(xcb_res_query_client_ids(xcon, 1, &spec));
+}
 
-	xcb_res_client_id_spec_t spec = {0};
-	spec.client = w;
-	spec.mask = XCB_RES_CLIENT_ID_MASK_LOCAL_CLIENT_PID;
+pid_t
+replypid(xcb_res_query_client_ids_cookie_t ck)
+{
+	pid_t result = 0;
+	xcb_res_client_id_spec_t spec;
 
 	xcb_generic_error_t *e = NULL;
-	xcb_res_query_client_ids_cookie_t c = xcb_res_query_client_ids(xcon, 1, &spec);
-	xcb_res_query_client_ids_reply_t *r = xcb_res_query_client_ids_reply(xcon, c, &e);
+	xcb_res_query_client_ids_reply_t *r = xcb_res_query_client_ids_reply(xcon, ck, &e);
 
+	free(e);
 	if (!r)
 		return (pid_t)0;
 
@@ -3792,15 +5540,21 @@ getparentprocess(pid_t p)
 	unsigned int v = 0;
 
 #ifdef __linux__
-	FILE *f;
-	char buf[256];
+	int fd;
+	ssize_t n;
+	char buf[512], *s;
 	snprintf(buf, sizeof(buf) - 1, "/proc/%u/stat", (unsigned)p);
 
-	if (!(f = fopen(buf, "r")))
+	if ((fd = open(buf, O_RDONLY | O_CLOEXEC)) == -1)
 		return 0;
-
-	fscanf(f, "%*u %*s %*c %u", &v);
-	fclose(f);
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+		return 0;
+	buf[n] = '\0';
+	/* the command name may hold spaces and parentheses itself */
+	if ((s = strrchr(buf, ')')))
+		sscanf(s + 1, " %*c %u", &v);
 #endif /* __linux__*/
 
 	return (pid_t)v;
@@ -3810,26 +5564,172 @@ int
 isdescprocess(pid_t p, pid_t c)
 {
 	while (p != c && c != 0)
-		c = getparentprocess(c);
+		c = procparent(c);
 
 	return (int)c;
 }
 
+/* the parent of pid, from the cache while pid lives; a pidfd in the epoll set
+ * tells when it exits and its pid may be reused */
+pid_t
+procparent(pid_t pid)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	struct pollfd pfd = { .events = POLLIN };
+	Proc *p, **tp;
+	pid_t ppid;
+	int fd = -1;
+
+	for (p = proctab[PROCHASH(pid)]; p && p->pid != pid; p = p->next);
+	if (p) {
+		if (p != procnewest) {
+			p->newer->older = p->older;
+			if (p->older)
+				p->older->newer = p->newer;
+			else
+				procoldest = p->newer;
+			p->newer = NULL;
+			p->older = procnewest;
+			procnewest = procnewest->newer = p;
+		}
+		if (p->stale) {
+			/* an exit still pending in this batch leaves the pidfd readable */
+			pfd.fd = p->fd;
+			if (poll(&pfd, 1, 0) || !(ppid = getparentprocess(pid)))
+				return 0;
+			for (tp = &prockids[PROCHASH(p->ppid)]; *tp != p; tp = &(*tp)->sibling);
+			*tp = p->sibling;
+			p->ppid = ppid;
+			p->sibling = prockids[PROCHASH(ppid)];
+			prockids[PROCHASH(ppid)] = p;
+			p->stale = 0;
+		}
+		return p->ppid;
+	}
+#ifdef SYS_pidfd_open
+	/* the evicted pidfd may have an event later in this batch, so it stays
+	 * open until procbury(); with no room for it, pid is not cached */
+	if (nproc == PROCMAX) {
+		if (nprocgraves == PROCMAX)
+			return getparentprocess(pid);
+		procgraves[nprocgraves++] = procevict(procoldest);
+	}
+	/* open the pidfd first, so a pid reused before the read is no worry */
+	fd = syscall(SYS_pidfd_open, pid, 0);
+#endif /* SYS_pidfd_open */
+	if (!(ppid = getparentprocess(pid)) || fd == -1) {
+		if (fd != -1)
+			close(fd);
+		return ppid;
+	}
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+		close(fd);
+		return ppid;
+	}
+	p = ecalloc(1, sizeof(Proc));
+	p->pid = pid;
+	p->ppid = ppid;
+	p->fd = fd;
+	p->next = proctab[PROCHASH(pid)];
+	proctab[PROCHASH(pid)] = p;
+	p->sibling = prockids[PROCHASH(ppid)];
+	prockids[PROCHASH(ppid)] = p;
+	p->fdnext = procfds[PROCHASH(fd)];
+	procfds[PROCHASH(fd)] = p;
+	if ((p->older = procnewest))
+		procnewest->newer = p;
+	else
+		procoldest = p;
+	procnewest = p;
+	nproc++;
+	return ppid;
+}
+
+/* whether fd is the pidfd of a cached process, which is gone then; its
+ * children have been reparented and read their parent again when next asked */
+int
+procexited(int fd)
+{
+	Proc *p, *k;
+
+	for (p = procfds[PROCHASH(fd)]; p && p->fd != fd; p = p->fdnext);
+	if (!p)
+		return 0;
+	for (k = prockids[PROCHASH(p->pid)]; k; k = k->sibling)
+		if (k->ppid == p->pid)
+			k->stale = 1;
+	close(procevict(p));
+	return 1;
+}
+
+/* unlinks p and hands back its pidfd, which the caller closes once no event
+ * of the current batch can name it */
+int
+procevict(Proc *p)
+{
+	Proc **tp;
+	int fd = p->fd;
+
+
+	for (tp = &proctab[PROCHASH(p->pid)]; *tp != p; tp = &(*tp)->next);
+	*tp = p->next;
+	for (tp = &prockids[PROCHASH(p->ppid)]; *tp != p; tp = &(*tp)->sibling);
+	*tp = p->sibling;
+	for (tp = &procfds[PROCHASH(p->fd)]; *tp != p; tp = &(*tp)->fdnext);
+	*tp = p->fdnext;
+	if (p->newer)
+		p->newer->older = p->older;
+	else
+		procnewest = p->older;
+	if (p->older)
+		p->older->newer = p->newer;
+	else
+		procoldest = p->newer;
+	free(p);
+	nproc--;
+	return fd;
+}
+
+void
+procbury(void)
+{
+	while (nprocgraves)
+		close(procgraves[--nprocgraves]);
+}
+
+void
+attachterm(Client *c)
+{
+	c->tnext = termtab[PROCHASH(c->pid)];
+	termtab[PROCHASH(c->pid)] = c;
+}
+
+void
+detachterm(Client *c)
+{
+	Client **tc;
+
+	for (tc = &termtab[PROCHASH(c->pid)]; *tc && *tc != c; tc = &(*tc)->tnext);
+	if (*tc)
+		*tc = c->tnext;
+}
+
 Client *
 termforwin(const Client *w)
 {
 	Client *c;
-	Monitor *m;
+	pid_t p, self = getpid();
 
 	if (!w->pid || w->isterminal)
 		return NULL;
 
-	for (m = mons; m; m = m->next) {
-		for (c = m->clients; c; c = c->next) {
-			if (c->isterminal && !c->swallowing && c->pid && isdescprocess(c->pid, w->pid))
+	/* the closest terminal among the ancestors of w; terminals started from
+	 * dwm are below it, so its own ancestors are not worth a pidfd each */
+	for (p = w->pid; p && p != self; p = procparent(p))
+		for (c = termtab[PROCHASH(p)]; c; c = c->tnext)
+			if (c->pid == p && !c->swallowing)
 				return c;
-		}
-	}
 
 	return NULL;
 }
@@ -3838,16 +5738,9 @@ Client *
 swallowingclient(Window w)
 {
 	Client *c;
-	Monitor *m;
-
-	for (m = mons; m; m = m->next) {
-		for (c = m->clients; c; c = c->next) {
-			if (c->swallowing && c->swallowing->win == w)
-				return c;
-		}
-	}
 
-	return NULL;
+	for (c = swaltab[WINHASH(w)]; c && c->swallowing->win != w; c = c->swnext);
+	return c;
 }
 
 
@@ -3858,13 +5751,9 @@ Client *
 wintoclient(Window w)
 {
 	Client *c;
-	Monitor *m;
 
-	for (m = mons; m; m = m->next)
-		for (c = m->clients; c; c = c->next)
-			if (c->win == w)
-				return c;
-	return NULL;
+	for (c = wintab[WINHASH(w)]; c && c->win != w; c = c->hnext);
+	return c;
 }
 
 Monitor *
@@ -337,6 +337,59 @@ dump_focused_state_change_event(yajl_gen gen, const int mon_num,
   return 0;
 }
 
+int
+dump_change(yajl_gen gen, const IPCChange *change)
+{
+  static const char *names[] = {
+      [IPC_CHANGE_CLIENT_ADDED] = "client_added",
+      [IPC_CHANGE_CLIENT_REMOVED] = "client_removed",
+      [IPC_CHANGE_CLIENT_MOVED] = "client_moved",
+      [IPC_CHANGE_CLIENT_TITLE] = "client_title",
+      [IPC_CHANGE_CLIENT_FOCUS] = "client_focus",
+      [IPC_CHANGE_TAG_STATE] = "tag_state",
+      [IPC_CHANGE_LAYOUT] = "layout",
+      [IPC_CHANGE_MONITOR_FOCUS] = "monitor_focus",
+  };
+
+  // clang-format off
+  YMAP(
+    YSTR("seq"); YINT(change->seq);
+    YSTR("type"); YSTR(names[change->type]);
+    YSTR("monitor_number"); YINT(change->mon_num);
+
+    switch (change->type) {
+    case IPC_CHANGE_CLIENT_ADDED:
+      YSTR("client_window_id"); YINT(change->win);
+      YSTR("tags"); YINT(change->tags);
+      YSTR("name"); YSTR(change->text);
+      break;
+    case IPC_CHANGE_CLIENT_MOVED:
+      YSTR("client_window_id"); YINT(change->win);
+      YSTR("tags"); YINT(change->tags);
+      break;
+    case IPC_CHANGE_CLIENT_TITLE:
+      YSTR("client_window_id"); YINT(change->win);
+      YSTR("name"); YSTR(change->text);
+      break;
+    case IPC_CHANGE_CLIENT_REMOVED:
+    case IPC_CHANGE_CLIENT_FOCUS:
+      YSTR("client_window_id"); YINT(change->win);
+      break;
+    case IPC_CHANGE_TAG_STATE:
+      YSTR("tag_state"); dump_tag_state(gen, change->tag_state);
+      break;
+    case IPC_CHANGE_LAYOUT:
+      YSTR("layout_symbol"); YSTR(change->text);
+      break;
+    case IPC_CHANGE_MONITOR_FOCUS:
+      break;
+    }
+  )
+  // clang-format on
+
+  return 0;
+}
+
 int
 dump_error_message(yajl_gen gen, const char *reason)
 {
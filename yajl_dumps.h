@@ -60,6 +60,8 @@ int dump_focused_state_change_event(yajl_gen gen, const int mon_num,
                                     const ClientState *old_state,
                                     const ClientState *new_state);
 
+int dump_change(yajl_gen gen, const IPCChange *change);
+
 int dump_error_message(yajl_gen gen, const char *reason);
 
 #endif  // YAJL_DUMPS_H_